@@ -0,0 +1,276 @@
+#pragma once
+
+// Read-only symbol/group catalog published by the mt4api plugin into shared memory.
+// Header-only, so co-located services can include it without linking anything.
+//
+// The region is guarded by a single seqlock: the writer makes the sequence odd while it
+// updates a record and even again when done. Readers copy what they need and retry if the
+// sequence moved, so lookups never block the plugin and never take a lock.
+
+#include <windows.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <string_view>
+#include <thread>
+
+namespace catalog
+{
+	constexpr uint32_t magic = 0x4334544D; // "MT4C"
+	constexpr uint32_t layout_version = 1;
+
+	constexpr size_t max_symbols = 1024;
+	constexpr size_t max_groups = 4096;
+	constexpr size_t max_sec_groups = 32;
+	constexpr size_t max_margins = 128;
+
+	constexpr uint16_t invalid_id = 0xFFFF;
+
+	struct symbol_record
+	{
+		int32_t		present;
+		char		name[12];
+		char		description[64];
+		char		currency[12];
+		char		margin_currency[12];
+		int32_t		type;				// index into group_record::sec
+		int32_t		digits;
+		int32_t		trade;				// TRADE_NO, TRADE_CLOSE, TRADE_FULL
+		int32_t		long_only;
+		int32_t		exemode;
+		int32_t		stops_level;
+		int32_t		freeze_level;
+		int32_t		profit_mode;
+		int32_t		margin_mode;
+		double		contract_size;
+		double		tick_size;
+		double		tick_value;
+		double		point;
+		double		swap_long;
+		double		swap_short;
+		double		margin_initial;
+		double		margin_divider;
+	};
+
+	struct group_sec_record
+	{
+		int32_t		show;
+		int32_t		trade;
+		int32_t		execution;
+		int32_t		lot_min;
+		int32_t		lot_max;
+		int32_t		lot_step;
+	};
+
+	struct margin_record
+	{
+		uint16_t	symbol;				// symbol id
+		uint16_t	reserved[3];
+		double		swap_long;
+		double		swap_short;
+		double		margin_divider;
+	};
+
+	struct group_record
+	{
+		int32_t				present;
+		char				name[16];
+		char				currency[12];
+		int32_t				enable;
+		int32_t				default_leverage;
+		int32_t				margin_call;
+		int32_t				margin_stopout;
+		int32_t				margin_mode;
+		int32_t				margins_total;
+		group_sec_record	sec[max_sec_groups];
+		margin_record		margins[max_margins];
+	};
+
+	struct header
+	{
+		uint32_t				magic;
+		uint32_t				layout_version;
+		std::atomic<uint64_t>	sequence;
+		uint64_t				config_version;		// same version as the mt4_symbol stream
+		uint32_t				symbols_total;		// ids below this may be present
+		uint32_t				groups_total;
+	};
+
+	struct region
+	{
+		header			head;
+		symbol_record	symbols[max_symbols];
+		group_record	groups[max_groups];
+	};
+
+	static_assert(std::atomic<uint64_t>::is_always_lock_free, "The sequence must be usable across processes");
+
+	class reader
+	{
+		static constexpr int max_attempts = 1024;
+
+	public:
+		reader() = default;
+		reader(const reader&) = delete;
+		reader& operator= (const reader&) = delete;
+
+		~reader()
+		{
+			close();
+		}
+
+		bool open(const char* name)
+		{
+			close();
+			m_mapping = OpenFileMappingA(FILE_MAP_READ, FALSE, name);
+			if (m_mapping == nullptr)
+			{
+				return false;
+			}
+			m_region = static_cast<const region*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, sizeof(region)));
+			if (m_region == nullptr || m_region->head.magic != magic || m_region->head.layout_version != layout_version)
+			{
+				close();
+				return false;
+			}
+			return true;
+		}
+
+		void close()
+		{
+			if (m_region != nullptr)
+			{
+				UnmapViewOfFile(m_region);
+				m_region = nullptr;
+			}
+			if (m_mapping != nullptr)
+			{
+				CloseHandle(m_mapping);
+				m_mapping = nullptr;
+			}
+		}
+
+		bool is_open() const noexcept { return m_region != nullptr; }
+
+		// Runs visit on a consistent state of the catalog. The visitor may run several times
+		// and must only copy data out, never act on it before read() returns true.
+		template<typename Visitor>
+		bool read(Visitor&& visit) const
+		{
+			const auto& sequence = m_region->head.sequence;
+			for (int attempt = 0; attempt < max_attempts; ++attempt)
+			{
+				const auto before = sequence.load(std::memory_order_acquire);
+				if (before & 1)
+				{
+					std::this_thread::yield();
+					continue;
+				}
+				visit(*m_region);
+				std::atomic_thread_fence(std::memory_order_acquire);
+				if (sequence.load(std::memory_order_relaxed) == before)
+				{
+					return true;
+				}
+			}
+			return false;
+		}
+
+		std::optional<uint64_t> version() const
+		{
+			uint64_t value{ 0 };
+			if (!read([&value](const region& r) { value = r.head.config_version; }))
+			{
+				return std::nullopt;
+			}
+			return value;
+		}
+
+		std::optional<symbol_record> symbol(uint16_t id) const
+		{
+			return copy_record<symbol_record>(id, max_symbols, [](const region& r, uint16_t i) -> const symbol_record& { return r.symbols[i]; });
+		}
+
+		std::optional<group_record> group(uint16_t id) const
+		{
+			return copy_record<group_record>(id, max_groups, [](const region& r, uint16_t i) -> const group_record& { return r.groups[i]; });
+		}
+
+		uint16_t find_symbol(const std::string_view name) const
+		{
+			return find(name, max_symbols, [](const region& r, uint16_t i) { return r.symbols[i].present ? bounded(r.symbols[i].name) : std::string_view{}; },
+				[](const region& r) { return r.head.symbols_total; });
+		}
+
+		uint16_t find_group(const std::string_view name) const
+		{
+			return find(name, max_groups, [](const region& r, uint16_t i) { return r.groups[i].present ? bounded(r.groups[i].name) : std::string_view{}; },
+				[](const region& r) { return r.head.groups_total; });
+		}
+
+		// Mirrors the plugin's group_symbol rules: the symbol's security group must be shown for the group.
+		bool is_visible(uint16_t group_id, uint16_t symbol_id) const
+		{
+			bool visible{ false };
+			const auto ok = read([&](const region& r)
+			{
+				visible = false;
+				if (group_id < max_groups && symbol_id < max_symbols && r.groups[group_id].present && r.symbols[symbol_id].present)
+				{
+					const auto type = r.symbols[symbol_id].type;
+					visible = type >= 0 && type < static_cast<int32_t>(max_sec_groups) && r.groups[group_id].sec[type].show != 0;
+				}
+			});
+			return ok && visible;
+		}
+
+	private:
+		// A name may be torn while the writer is busy, so never rely on its terminator.
+		template<size_t Size>
+		static std::string_view bounded(const char (&name)[Size]) noexcept
+		{
+			return std::string_view{ name, strnlen(name, Size) };
+		}
+
+		template<typename Record, typename Select>
+		std::optional<Record> copy_record(uint16_t id, size_t capacity, Select select) const
+		{
+			if (id >= capacity)
+			{
+				return std::nullopt;
+			}
+			Record record{};
+			if (!read([&](const region& r) { std::memcpy(&record, &select(r, id), sizeof(Record)); }) || !record.present)
+			{
+				return std::nullopt;
+			}
+			return record;
+		}
+
+		template<typename Name, typename Total>
+		uint16_t find(const std::string_view name, size_t capacity, Name name_of, Total total_of) const
+		{
+			uint16_t found{ invalid_id };
+			const auto ok = read([&](const region& r)
+			{
+				found = invalid_id;
+				const auto total = static_cast<uint16_t>(std::min<size_t>(total_of(r), capacity));
+				for (uint16_t i = 0; i < total; ++i)
+				{
+					if (name_of(r, i) == name)
+					{
+						found = i;
+						break;
+					}
+				}
+			});
+			return ok ? found : invalid_id;
+		}
+
+		HANDLE			m_mapping{ nullptr };
+		const region*	m_region{ nullptr };
+	};
+}
@@ -0,0 +1,149 @@
+#include "account_cache.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+#include "mt4.h"
+
+namespace mt4
+{
+	account make_account(const UserRecord& record, const registry& ids)
+	{
+		return account{
+			.login = record.login,
+			.group = ids.groups.find(std::string_view{ record.group, strnlen(record.group, sizeof(record.group)) }),
+			.leverage = record.leverage,
+			.enabled = record.enable != FALSE,
+			.read_only = record.enable_read_only != FALSE,
+		};
+	}
+
+	account_cache::account_cache(size_t capacity)
+		: m_slots{ new slot[std::bit_ceil(std::max<size_t>(capacity, 16))] }
+		, m_mask{ std::bit_ceil(std::max<size_t>(capacity, 16)) - 1 }
+	{
+	}
+
+	std::optional<account> account_cache::find(int login) const noexcept
+	{
+		if (login <= 0)
+		{
+			return std::nullopt;
+		}
+		for (auto index = home(login);; index = (index + 1) & m_mask)
+		{
+			const auto& entry = m_slots[index];
+			const auto current = entry.login.load(std::memory_order_acquire);
+			if (current == empty_login)
+			{
+				return std::nullopt;
+			}
+			if (current != login)
+			{
+				continue;
+			}
+			const auto fields = entry.fields.load(std::memory_order_acquire);
+			// The slot could have been erased and reused while the fields were read.
+			if (entry.login.load(std::memory_order_acquire) != login)
+			{
+				return find(login);
+			}
+			return unpack(login, fields);
+		}
+	}
+
+	bool account_cache::upsert(const account& entry)
+	{
+		if (entry.login <= 0)
+		{
+			return false;
+		}
+		std::lock_guard lock{ m_write_mutex };
+		slot* reusable{ nullptr };
+		for (auto index = home(entry.login);; index = (index + 1) & m_mask)
+		{
+			auto& target = m_slots[index];
+			const auto current = target.login.load(std::memory_order_relaxed);
+			if (current == entry.login)
+			{
+				target.fields.store(pack(entry), std::memory_order_release);
+				return true;
+			}
+			if (current == erased_login && reusable == nullptr)
+			{
+				reusable = &target;
+			}
+			if (current != empty_login)
+			{
+				continue;
+			}
+			if (reusable == nullptr)
+			{
+				// Keeps an empty slot on every probe path, lookups stop there.
+				if (m_used >= capacity() / 4 * 3)
+				{
+					m_overflowed.store(true, std::memory_order_release);
+					return false;
+				}
+				reusable = &target;
+				++m_used;
+			}
+			// Fields first, a reader that sees the login must see them too.
+			reusable->fields.store(pack(entry), std::memory_order_release);
+			reusable->login.store(entry.login, std::memory_order_release);
+			m_size.fetch_add(1, std::memory_order_relaxed);
+			return true;
+		}
+	}
+
+	void account_cache::erase(int login)
+	{
+		if (login <= 0)
+		{
+			return;
+		}
+		std::lock_guard lock{ m_write_mutex };
+		for (auto index = home(login);; index = (index + 1) & m_mask)
+		{
+			auto& target = m_slots[index];
+			const auto current = target.login.load(std::memory_order_relaxed);
+			if (current == empty_login)
+			{
+				return;
+			}
+			if (current == login)
+			{
+				// A tombstone rather than an empty slot, later logins on this probe path stay reachable.
+				target.login.store(erased_login, std::memory_order_release);
+				m_size.fetch_sub(1, std::memory_order_relaxed);
+				return;
+			}
+		}
+	}
+
+	uint64_t account_cache::pack(const account& entry) noexcept
+	{
+		return static_cast<uint64_t>(static_cast<uint32_t>(entry.leverage))
+			| static_cast<uint64_t>(entry.group) << 32
+			| static_cast<uint64_t>(entry.enabled ? 1 : 0) << 48
+			| static_cast<uint64_t>(entry.read_only ? 1 : 0) << 49;
+	}
+
+	account account_cache::unpack(int login, uint64_t fields) noexcept
+	{
+		return account{
+			.login = login,
+			.group = static_cast<group_id>(fields >> 32),
+			.leverage = static_cast<int>(static_cast<uint32_t>(fields)),
+			.enabled = ((fields >> 48) & 1) != 0,
+			.read_only = ((fields >> 49) & 1) != 0,
+		};
+	}
+
+	// Fibonacci hashing spreads the consecutive logins servers hand out across the table.
+	size_t account_cache::home(int login) const noexcept
+	{
+		return static_cast<size_t>((static_cast<uint64_t>(static_cast<uint32_t>(login)) * 0x9E3779B97F4A7C15ull) >> 32) & m_mask;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+
+#include "registry.h"
+
+struct UserRecord;
+
+namespace mt4
+{
+	// The UserRecord fields trade checks and routing look at.
+	struct account
+	{
+		int			login;
+		group_id	group;			// invalid_id for a group not in the configuration
+		int			leverage;
+		bool		enabled;
+		bool		read_only;
+	};
+
+	account make_account(const UserRecord& record, const registry& ids);
+
+	// Accounts by login in an open-addressing table with linear probing, so a lookup costs a
+	// hash and a few adjacent slots instead of a ClientsUserInfo call. Each slot is a login and
+	// the account fields packed into one word, both atomic: readers never lock, the user hooks
+	// and the seed write under a mutex.
+	class account_cache
+	{
+	public:
+		// Capacity is rounded up to a power of two, the table accepts up to 3/4 of it.
+		explicit account_cache(size_t capacity);
+
+		// Lock-free. Nothing for unknown logins, or for every login before the seed.
+		std::optional<account> find(int login) const noexcept;
+
+		// False when the table is full, lookups of that login then miss.
+		bool upsert(const account& entry);
+		void erase(int login);
+
+		// Set once the seed went through every account. From then on a miss means an unknown
+		// login, unless some account didn't fit.
+		void set_ready() noexcept { m_ready.store(true, std::memory_order_release); }
+		bool ready() const noexcept { return m_ready.load(std::memory_order_acquire) && !m_overflowed.load(std::memory_order_acquire); }
+
+		size_t size() const noexcept { return m_size.load(std::memory_order_relaxed); }
+		size_t capacity() const noexcept { return m_mask + 1; }
+
+	private:
+		static constexpr int empty_login = 0;
+		static constexpr int erased_login = -1;
+
+		struct slot
+		{
+			std::atomic<int>		login{ empty_login };
+			std::atomic<uint64_t>	fields{ 0 };
+		};
+
+		static uint64_t pack(const account& entry) noexcept;
+		static account unpack(int login, uint64_t fields) noexcept;
+		size_t home(int login) const noexcept;
+
+		std::unique_ptr<slot[]>		m_slots;
+		const size_t				m_mask;
+		std::mutex					m_write_mutex;
+		std::atomic<size_t>			m_size{ 0 };
+		size_t						m_used{ 0 };		// live and erased slots, under the write mutex
+		std::atomic<bool>			m_ready{ false };
+		std::atomic<bool>			m_overflowed{ false };
+	};
+}
\ No newline at end of file
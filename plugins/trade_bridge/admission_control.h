@@ -0,0 +1,118 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+#include <tl/expected.hpp>
+
+namespace mt4
+{
+	// Bounds the work the trade path accepts, so under overload clients get an immediate reject
+	// instead of waiting out their timeout. A request is refused on arrival when too many are in
+	// flight or when recent requests waited longer than the queue budget, and dropped before
+	// execution when it has itself waited longer than that.
+	class admission_control
+	{
+		using clock_t = std::chrono::steady_clock;
+
+	public:
+		struct counters
+		{
+			uint64_t	admitted;
+			uint64_t	shed_in_flight;		// refused on arrival, in-flight budget exhausted
+			uint64_t	shed_queue_delay;	// refused on arrival, recent queue delay over budget
+			uint64_t	expired;			// admitted, dropped after waiting over budget
+			uint64_t	queue_full;
+			size_t		in_flight;
+			uint64_t	queue_delay_us;		// smoothed wait of the latest dispatched requests
+		};
+
+		admission_control(size_t max_in_flight, std::chrono::milliseconds max_queue_delay) noexcept
+			: m_max_in_flight{ std::max<size_t>(max_in_flight, 1) }
+			, m_max_queue_delay_us{ std::chrono::duration_cast<std::chrono::microseconds>(max_queue_delay).count() }
+		{
+		}
+
+		// Every admitted request must be released once, whatever its outcome.
+		tl::expected<void, std::string> try_admit() noexcept
+		{
+			if (m_queue_delay_us.load(std::memory_order_relaxed) > m_max_queue_delay_us)
+			{
+				m_shed_queue_delay.fetch_add(1, std::memory_order_relaxed);
+				return tl::unexpected{ std::string{ "Trade queue is too slow, retry later" } };
+			}
+			if (m_in_flight.fetch_add(1, std::memory_order_relaxed) >= m_max_in_flight)
+			{
+				m_in_flight.fetch_sub(1, std::memory_order_relaxed);
+				m_shed_in_flight.fetch_add(1, std::memory_order_relaxed);
+				return tl::unexpected{ std::string{ "Too many trade requests in flight, retry later" } };
+			}
+			m_admitted.fetch_add(1, std::memory_order_relaxed);
+			return {};
+		}
+
+		// Called by the worker before execution, false when the request has expired in the queue.
+		bool on_dispatched(clock_t::duration waited) noexcept
+		{
+			const auto waited_us = std::chrono::duration_cast<std::chrono::microseconds>(waited).count();
+			// Exponential moving average over roughly the last eight requests, lost updates don't matter.
+			const auto average = m_queue_delay_us.load(std::memory_order_relaxed);
+			m_queue_delay_us.store(average + (waited_us - average) / 8, std::memory_order_relaxed);
+			if (waited_us > m_max_queue_delay_us)
+			{
+				m_expired.fetch_add(1, std::memory_order_relaxed);
+				return false;
+			}
+			return true;
+		}
+
+		void on_queue_full() noexcept
+		{
+			m_queue_full.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		void release() noexcept
+		{
+			// Once the queues are drained nothing refreshes the average, so it starts over.
+			if (m_in_flight.fetch_sub(1, std::memory_order_relaxed) == 1)
+			{
+				m_queue_delay_us.store(0, std::memory_order_relaxed);
+			}
+		}
+
+		// Admitted requests not yet released, background work backs off while there are any.
+		size_t in_flight() const noexcept
+		{
+			return m_in_flight.load(std::memory_order_relaxed);
+		}
+
+		// Event counters cover the interval since the previous call.
+		counters drain() noexcept
+		{
+			return counters{
+				.admitted = m_admitted.exchange(0, std::memory_order_relaxed),
+				.shed_in_flight = m_shed_in_flight.exchange(0, std::memory_order_relaxed),
+				.shed_queue_delay = m_shed_queue_delay.exchange(0, std::memory_order_relaxed),
+				.expired = m_expired.exchange(0, std::memory_order_relaxed),
+				.queue_full = m_queue_full.exchange(0, std::memory_order_relaxed),
+				.in_flight = m_in_flight.load(std::memory_order_relaxed),
+				.queue_delay_us = static_cast<uint64_t>(std::max<int64_t>(m_queue_delay_us.load(std::memory_order_relaxed), 0))
+			};
+		}
+
+	private:
+		const size_t				m_max_in_flight;
+		const int64_t				m_max_queue_delay_us;
+
+		std::atomic<size_t>			m_in_flight{ 0 };
+		std::atomic<int64_t>		m_queue_delay_us{ 0 };
+		std::atomic<uint64_t>		m_admitted{ 0 };
+		std::atomic<uint64_t>		m_shed_in_flight{ 0 };
+		std::atomic<uint64_t>		m_shed_queue_delay{ 0 };
+		std::atomic<uint64_t>		m_expired{ 0 };
+		std::atomic<uint64_t>		m_queue_full{ 0 };
+	};
+}
\ No newline at end of file
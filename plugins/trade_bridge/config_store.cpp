@@ -0,0 +1,210 @@
+#include "config_store.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include "mt4.h"
+
+namespace
+{
+	uint64_t initial_version()
+	{
+		// Seeded from the wall clock so versions keep growing across plugin restarts.
+		return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+			std::chrono::system_clock::now().time_since_epoch()).count());
+	}
+
+	template<typename T>
+	void put(std::vector<std::shared_ptr<const T>>& slots, uint16_t id, const T& value)
+	{
+		if (id >= slots.size())
+		{
+			slots.resize(static_cast<size_t>(id) + 1);
+		}
+		slots[id] = std::make_shared<const T>(value);
+	}
+
+	std::shared_ptr<const mt4::group_masks> make_masks(const ConGroup& group, const std::vector<std::shared_ptr<const ConSymbol>>& symbols)
+	{
+		auto masks = std::make_shared<mt4::group_masks>();
+		for (mt4::symbol_id id = 0; id < symbols.size(); ++id)
+		{
+			mt4::set_symbol_masks(*masks, group, id, symbols[id].get());
+		}
+		return masks;
+	}
+}
+
+namespace mt4
+{
+	void set_symbol_masks(group_masks& masks, const ConGroup& group, symbol_id id, const ConSymbol* symbol)
+	{
+		bool visible{ false }, tradeable{ false }, close_only{ false }, long_only{ false };
+		if (symbol != nullptr && symbol->type >= 0 && symbol->type < MAX_SEC_GROUPS)
+		{
+			const auto& sec = group.secgroups[symbol->type];
+			visible = sec.show != 0;
+			// Same precedence as the published trade mode: a group without trade rights
+			// wins over long-only, which wins over the symbol's own mode.
+			const auto allowed = visible && sec.trade != 0;
+			long_only = allowed && symbol->long_only != 0;
+			tradeable = long_only || (allowed && symbol->trade == TRADE_FULL);
+			close_only = allowed && !long_only && symbol->trade == TRADE_CLOSE;
+		}
+		masks.visible.set(id, visible);
+		masks.tradeable.set(id, tradeable);
+		masks.close_only.set(id, close_only);
+		masks.long_only.set(id, long_only);
+	}
+
+	config_store::config_store()
+	{
+		auto view = std::make_shared<config_view>();
+		view->m_version = initial_version();
+		m_view.store(std::move(view), std::memory_order_release);
+	}
+
+	config_store::view_ptr_t config_store::view() const noexcept
+	{
+		return m_view.load(std::memory_order_acquire);
+	}
+
+	std::vector<std::string> config_store::load(CServerInterface* mt4server, registry& ids)
+	{
+		std::lock_guard lock{ m_write_mutex };
+
+		std::vector<std::string> skipped{};
+		auto view = copy_view();
+		view->m_groups.clear();
+		view->m_symbols.clear();
+		view->m_masks.clear();
+
+		ConSymbol symbol{};
+		for (int i = 0; mt4server->SymbolsNext(i, &symbol); ++i)
+		{
+			if (const auto id = ids.symbols.intern(symbol.symbol); id != invalid_id)
+			{
+				put(view->m_symbols, id, symbol);
+			}
+			else
+			{
+				skipped.emplace_back(symbol.symbol);
+			}
+		}
+
+		ConGroup group{};
+		for (int i = 0; mt4server->GroupsNext(i, &group); ++i)
+		{
+			if (const auto id = ids.groups.intern(group.group); id != invalid_id)
+			{
+				put(view->m_groups, id, group);
+			}
+			else
+			{
+				skipped.emplace_back(group.group);
+			}
+		}
+
+		view->m_masks.resize(view->m_groups.size());
+		for (group_id id = 0; id < view->m_groups.size(); ++id)
+		{
+			if (view->m_groups[id] != nullptr)
+			{
+				view->m_masks[id] = make_masks(*view->m_groups[id], view->m_symbols);
+			}
+		}
+
+		publish(std::move(view));
+		return skipped;
+	}
+
+	config_store::view_ptr_t config_store::update(group_id id, const ConGroup& group, const mirror_t& mirror)
+	{
+		std::lock_guard lock{ m_write_mutex };
+
+		auto view = copy_view();
+		put(view->m_groups, id, group);
+		view->m_masks.resize(view->m_groups.size());
+		view->m_masks[id] = make_masks(group, view->m_symbols);
+		return publish(std::move(view), mirror);
+	}
+
+	config_store::view_ptr_t config_store::update(symbol_id id, const ConSymbol& symbol, const mirror_t& mirror)
+	{
+		std::lock_guard lock{ m_write_mutex };
+
+		auto view = copy_view();
+		put(view->m_symbols, id, symbol);
+		// One bit per group changes, but views are immutable, so every group gets a fresh copy.
+		for (group_id group = 0; group < view->m_masks.size(); ++group)
+		{
+			if (view->m_masks[group] != nullptr)
+			{
+				auto masks = std::make_shared<group_masks>(*view->m_masks[group]);
+				set_symbol_masks(*masks, *view->m_groups[group], id, &symbol);
+				view->m_masks[group] = std::move(masks);
+			}
+		}
+		return publish(std::move(view), mirror);
+	}
+
+	config_store::view_ptr_t config_store::erase_group(group_id id, const mirror_t& mirror)
+	{
+		std::lock_guard lock{ m_write_mutex };
+
+		auto view = copy_view();
+		if (id < view->m_groups.size())
+		{
+			view->m_groups[id] = nullptr;
+			view->m_masks[id] = nullptr;
+		}
+		return publish(std::move(view), mirror);
+	}
+
+	config_store::view_ptr_t config_store::erase_symbol(symbol_id id, const mirror_t& mirror)
+	{
+		std::lock_guard lock{ m_write_mutex };
+
+		auto view = copy_view();
+		if (id < view->m_symbols.size())
+		{
+			view->m_symbols[id] = nullptr;
+		}
+		for (group_id group = 0; group < view->m_masks.size(); ++group)
+		{
+			if (view->m_masks[group] != nullptr)
+			{
+				auto masks = std::make_shared<group_masks>(*view->m_masks[group]);
+				set_symbol_masks(*masks, *view->m_groups[group], id, nullptr);
+				view->m_masks[group] = std::move(masks);
+			}
+		}
+		return publish(std::move(view), mirror);
+	}
+
+	config_store::view_ptr_t config_store::advance(uint64_t version)
+	{
+		std::lock_guard lock{ m_write_mutex };
+
+		auto view = copy_view();
+		view->m_version = std::max(view->m_version, version);
+		return publish(std::move(view));
+	}
+
+	std::shared_ptr<config_view> config_store::copy_view() const
+	{
+		return std::make_shared<config_view>(*view());
+	}
+
+	config_store::view_ptr_t config_store::publish(std::shared_ptr<config_view> view, const mirror_t& mirror)
+	{
+		++view->m_version;
+		view_ptr_t result{ std::move(view) };
+		m_view.store(result, std::memory_order_release);
+		if (mirror)
+		{
+			mirror(*result);
+		}
+		return result;
+	}
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "registry.h"
+
+struct CServerInterface;
+struct ConGroup;
+struct ConSymbol;
+
+namespace mt4
+{
+	// Per-group symbol sets derived from ConGroup::secgroups and the symbol trade settings,
+	// so fan-out and trade checks don't re-derive them for every group x symbol pair.
+	struct group_masks
+	{
+		symbol_set	visible;		// secgroups[type].show
+		symbol_set	tradeable;		// new positions allowed, full or long-only
+		symbol_set	close_only;
+		symbol_set	long_only;
+	};
+
+	// Sets the symbol's bits in the group's masks, a null symbol clears them.
+	void set_symbol_masks(group_masks& masks, const ConGroup& group, symbol_id id, const ConSymbol* symbol);
+
+	// Immutable view of the server groups and symbols, indexed by registry ids.
+	// Entries are shared between views, so publishing a new view copies pointers only.
+	class config_view
+	{
+	public:
+		using group_ptr_t = std::shared_ptr<const ConGroup>;
+		using symbol_ptr_t = std::shared_ptr<const ConSymbol>;
+		using masks_ptr_t = std::shared_ptr<const group_masks>;
+
+		uint64_t version() const noexcept { return m_version; }
+
+		const ConGroup* group(group_id id) const noexcept
+		{
+			return id < m_groups.size() ? m_groups[id].get() : nullptr;
+		}
+
+		const ConSymbol* symbol(symbol_id id) const noexcept
+		{
+			return id < m_symbols.size() ? m_symbols[id].get() : nullptr;
+		}
+
+		const group_masks* masks(group_id id) const noexcept
+		{
+			return id < m_masks.size() ? m_masks[id].get() : nullptr;
+		}
+
+		bool is_visible(group_id group, symbol_id symbol) const noexcept
+		{
+			const auto masks = this->masks(group);
+			return masks != nullptr && masks->visible.test(symbol);
+		}
+
+		// Slots are indexed by id and may be empty.
+		const std::vector<group_ptr_t>& groups() const noexcept { return m_groups; }
+		const std::vector<symbol_ptr_t>& symbols() const noexcept { return m_symbols; }
+		const std::vector<masks_ptr_t>& masks() const noexcept { return m_masks; }
+
+	private:
+		friend class config_store;
+
+		uint64_t					m_version{ 0 };
+		std::vector<group_ptr_t>	m_groups;
+		std::vector<symbol_ptr_t>	m_symbols;
+		std::vector<masks_ptr_t>	m_masks;		// same slots as m_groups
+	};
+
+	// Copy-on-write store of the configuration. Readers grab the current view without
+	// locking and keep it alive for as long as they need a consistent picture; the
+	// configuration hooks publish a new view RCU-style.
+	class config_store
+	{
+	public:
+		using view_ptr_t = std::shared_ptr<const config_view>;
+		// Runs under the write lock with the view being published, so copies of the
+		// configuration kept elsewhere (the shared catalog) see the views in version order.
+		using mirror_t = std::function<void(const config_view& view)>;
+
+		config_store();
+
+		view_ptr_t view() const noexcept;
+
+		// Reloads everything from the server, returns names that did not fit into the registry.
+		std::vector<std::string> load(CServerInterface* mt4server, registry& ids);
+
+		view_ptr_t update(group_id id, const ConGroup& group, const mirror_t& mirror = {});
+		view_ptr_t update(symbol_id id, const ConSymbol& symbol, const mirror_t& mirror = {});
+
+		// Empties the slot, the id stays registered and a later add fills it again.
+		view_ptr_t erase_group(group_id id, const mirror_t& mirror = {});
+		view_ptr_t erase_symbol(symbol_id id, const mirror_t& mirror = {});
+
+		// Moves the version past one published by a previous plugin instance.
+		view_ptr_t advance(uint64_t version);
+
+	private:
+		std::shared_ptr<config_view> copy_view() const;
+		view_ptr_t publish(std::shared_ptr<config_view> view, const mirror_t& mirror = {});
+
+		std::mutex							m_write_mutex;
+		std::atomic<view_ptr_t>				m_view;
+	};
+}
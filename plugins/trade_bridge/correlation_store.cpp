@@ -0,0 +1,105 @@
+#include "correlation_store.h"
+
+#include <algorithm>
+#include <bit>
+
+namespace mt4
+{
+	correlation_store::correlation_store(size_t capacity)
+		: m_entries{ new entry_t[std::max<size_t>(capacity, 1)] }
+		, m_capacity{ std::max<size_t>(capacity, 1) }
+		, m_index(std::bit_ceil(m_capacity * 2), nil)
+	{
+		for (size_t i = 0; i < m_capacity; ++i)
+		{
+			m_entries[i].next_free = i + 1 < m_capacity ? static_cast<uint32_t>(i + 1) : nil;
+		}
+		m_free = 0;
+	}
+
+	tl::expected<correlation_store::handle, correlation_store::insert_error> correlation_store::insert(int login, int request_id, std::string_view reply_to)
+	{
+		const auto key = key_of(login, request_id);
+		const auto mask = m_index.size() - 1;
+
+		std::lock_guard lock{ m_mutex };
+		auto position = home_of(key);
+		for (; m_index[position] != nil; position = (position + 1) & mask)
+		{
+			if (m_entries[m_index[position]].key == key)
+			{
+				return tl::unexpected{ ALREADY_PENDING };
+			}
+		}
+		if (m_free == nil)
+		{
+			return tl::unexpected{ FULL };
+		}
+
+		const auto index = m_free;
+		auto& entry = m_entries[index];
+		m_free = entry.next_free;
+		entry.key = key;
+		entry.reply_to.assign(reply_to);
+		const auto generation = static_cast<uint32_t>(entry.tag.load(std::memory_order_relaxed) >> 8);
+		entry.tag.store(tag_of(generation, QUEUED), std::memory_order_release);
+		m_index[position] = index;
+		m_size.fetch_add(1, std::memory_order_relaxed);
+		return handle{ index, generation };
+	}
+
+	void correlation_store::erase(handle entry)
+	{
+		const auto mask = m_index.size() - 1;
+
+		std::lock_guard lock{ m_mutex };
+		auto& target = m_entries[entry.index];
+		if ((target.tag.load(std::memory_order_relaxed) >> 8) != entry.generation)
+		{
+			return;
+		}
+
+		auto hole = home_of(target.key);
+		while (m_index[hole] != entry.index)
+		{
+			hole = (hole + 1) & mask;
+		}
+		// Backward-shift deletion: pull later entries of the cluster into the hole unless that
+		// would move them before their home slot.
+		for (auto next = (hole + 1) & mask; m_index[next] != nil; next = (next + 1) & mask)
+		{
+			const auto home = home_of(m_entries[m_index[next]].key);
+			const auto distance_to_next = (next - home) & mask;
+			const auto distance_to_hole = (hole - home) & mask;
+			if (distance_to_hole <= distance_to_next)
+			{
+				m_index[hole] = m_index[next];
+				hole = next;
+			}
+		}
+		m_index[hole] = nil;
+
+		target.key = 0;
+		target.reply_to.clear();
+		target.tag.store(tag_of(entry.generation + 1, FREE), std::memory_order_release);
+		target.next_free = m_free;
+		m_free = entry.index;
+		m_size.fetch_sub(1, std::memory_order_relaxed);
+	}
+
+	uint64_t correlation_store::key_of(int login, int request_id) noexcept
+	{
+		return (uint64_t{ static_cast<uint32_t>(login) } << 32) | static_cast<uint32_t>(request_id);
+	}
+
+	bool correlation_store::transition(handle entry, state from, state to) noexcept
+	{
+		auto expected = tag_of(entry.generation, from);
+		return m_entries[entry.index].tag.compare_exchange_strong(expected, tag_of(entry.generation, to), std::memory_order_acq_rel);
+	}
+
+	size_t correlation_store::home_of(uint64_t key) const noexcept
+	{
+		return static_cast<size_t>((key * 0x9E3779B97F4A7C15ull) >> 32) & (m_index.size() - 1);
+	}
+}
\ No newline at end of file
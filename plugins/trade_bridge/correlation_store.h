@@ -0,0 +1,91 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <tl/expected.hpp>
+
+namespace mt4
+{
+	// Trade requests between admission and their response, keyed by login and request id. Each
+	// entry carries the reply subject and a state both the trade worker and the request deadline
+	// race for: whoever moves it out of QUEUED answers the request.
+	//
+	// Entries live in a fixed slab sized to the admission budget; the id index is open
+	// addressing with backward-shift deletion, so a lookup never walks tombstones.
+	class correlation_store
+	{
+	public:
+		enum state : uint8_t
+		{
+			FREE,
+			QUEUED,
+			EXECUTING,
+			EXPIRED
+		};
+
+		struct handle
+		{
+			uint32_t	index;
+			uint32_t	generation;
+		};
+
+		explicit correlation_store(size_t capacity);
+
+		correlation_store(const correlation_store&) = delete;
+		correlation_store& operator= (const correlation_store&) = delete;
+
+		enum insert_error
+		{
+			ALREADY_PENDING,
+			FULL
+		};
+
+		// The entry starts QUEUED.
+		tl::expected<handle, insert_error> insert(int login, int request_id, std::string_view reply_to);
+
+		// Worker side: QUEUED -> EXECUTING, false when the deadline already answered the request.
+		bool claim(handle entry) noexcept { return transition(entry, QUEUED, EXECUTING); }
+
+		// Deadline side: QUEUED -> EXPIRED, false when a worker already took the request.
+		bool expire(handle entry) noexcept { return transition(entry, QUEUED, EXPIRED); }
+
+		// Valid while the caller owns the entry, after a successful claim or expire.
+		std::string_view reply_to(handle entry) const noexcept { return m_entries[entry.index].reply_to; }
+
+		void erase(handle entry);
+
+		size_t size() const noexcept { return m_size.load(std::memory_order_relaxed); }
+
+	private:
+		struct entry_t
+		{
+			// generation << 8 | state, one word so a stale handle can't win a transition.
+			std::atomic<uint64_t>	tag{ 0 };
+			uint64_t				key{ 0 };
+			std::string				reply_to;
+			uint32_t				next_free;
+		};
+
+		static constexpr uint32_t nil = UINT32_MAX;
+
+		static uint64_t key_of(int login, int request_id) noexcept;
+		static uint64_t tag_of(uint32_t generation, state value) noexcept { return (uint64_t{ generation } << 8) | value; }
+
+		bool transition(handle entry, state from, state to) noexcept;
+		size_t home_of(uint64_t key) const noexcept;
+
+		std::unique_ptr<entry_t[]>	m_entries;
+		const size_t				m_capacity;
+
+		std::mutex					m_mutex;
+		std::vector<uint32_t>		m_index;		// entry index or nil, twice the capacity
+		uint32_t					m_free{ nil };
+		std::atomic<size_t>			m_size{ 0 };
+	};
+}
\ No newline at end of file
@@ -61,6 +61,7 @@ int APIENTRY MtSrvStartup(CServerInterface* server)
             return(FALSE);
 		}
 	    mt4plugin = std::move(mt4plugin_result.value());
+        mt4plugin->warm_up();
 
         //    plugin_info.name,
         //    "test1",
@@ -78,6 +79,10 @@ int APIENTRY MtSrvStartup(CServerInterface* server)
 void APIENTRY MtSrvCleanup()
 {
 	mt4logger->log_info("Unloading plugin, cleaning up resources");
+    if (mt4plugin)
+    {
+        mt4plugin->save_state();
+    }
     mt4plugin.reset();
     mt4logger.reset();
 }
@@ -100,7 +105,16 @@ int APIENTRY MtSrvGroupsAdd(const ConGroup* group)
 {
     if (mt4plugin)
     {
-        mt4plugin->handle(group);
+        mt4plugin->handle(group, false);
+    }
+    return (TRUE);
+}
+
+int APIENTRY MtSrvGroupsDelete(const ConGroup* group)
+{
+    if (mt4plugin)
+    {
+        mt4plugin->handle(group, true);
     }
     return (TRUE);
 }
@@ -109,11 +123,88 @@ int APIENTRY MtSrvSymbolsAdd(const ConSymbol* symbol)
 {
     if (mt4plugin)
     {
-        mt4plugin->handle(symbol);
+        mt4plugin->handle(symbol, false);
     }
     return (TRUE);
 }
 
+int APIENTRY MtSrvSymbolsDelete(const ConSymbol* symbol)
+{
+    if (mt4plugin)
+    {
+        mt4plugin->handle(symbol, true);
+    }
+    return (TRUE);
+}
+
+void APIENTRY MtSrvTradesAdd(TradeRecord* trade, const UserInfo*, const ConSymbol*)
+{
+    if (mt4plugin)
+    {
+        mt4plugin->handle(trade, mt4::trade_event::OPENED);
+    }
+}
+
+void APIENTRY MtSrvTradesUpdate(TradeRecord* trade, UserInfo*, const int mode)
+{
+    if (mt4plugin)
+    {
+        switch (mode)
+        {
+        case UPDATE_ACTIVATE:
+            mt4plugin->handle(trade, mt4::trade_event::ACTIVATED);
+            break;
+        case UPDATE_CLOSE:
+            mt4plugin->handle(trade, mt4::trade_event::CLOSED);
+            break;
+        case UPDATE_DELETE:
+            mt4plugin->handle(trade, mt4::trade_event::DELETED);
+            break;
+        default:
+            mt4plugin->handle(trade, mt4::trade_event::MODIFIED);
+            break;
+        }
+    }
+}
+
+void APIENTRY MtSrvTradesCloseBy(TradeRecord* ftrade, TradeRecord* strade, TradeRecord* remaind, ConSymbol*, UserInfo*)
+{
+    if (mt4plugin)
+    {
+        mt4plugin->handle(ftrade, mt4::trade_event::CLOSED_BY);
+        mt4plugin->handle(strade, mt4::trade_event::CLOSED_BY);
+        // What is left of the larger position reopens under a new ticket.
+        if (remaind != nullptr && remaind->order != 0)
+        {
+            mt4plugin->handle(remaind, mt4::trade_event::OPENED);
+        }
+    }
+}
+
+void APIENTRY MtSrvUserAdd(const UserRecord* info)
+{
+    if (mt4plugin)
+    {
+        mt4plugin->handle(info, false);
+    }
+}
+
+void APIENTRY MtSrvUserUpdate(const UserRecord* info)
+{
+    if (mt4plugin)
+    {
+        mt4plugin->handle(info, false);
+    }
+}
+
+void APIENTRY MtSrvUserDelete(const UserRecord* info)
+{
+    if (mt4plugin)
+    {
+        mt4plugin->handle(info, true);
+    }
+}
+
 void APIENTRY MtSrvHistoryTickApply(const ConSymbol*, FeedTick* tick)
 {
     if (mt4plugin)
@@ -0,0 +1,233 @@
+#include "equity_engine.h"
+
+#include "mt4.h"
+
+namespace
+{
+	// Deposit currency value of a one point move, signed by side.
+	double multiplier_of(const mt4::trade_event& position, const ConSymbol& symbol) noexcept
+	{
+		const auto lots = position.volume / 100.0;
+		const auto value = symbol.profit_mode == PROFIT_CALC_FUTURES && symbol.tick_size > 0.0
+			? symbol.tick_value / symbol.tick_size
+			: symbol.contract_size;
+		const auto rate = position.conv_rate > 0.0 ? position.conv_rate : 1.0;
+		return (position.cmd == OP_BUY ? 1.0 : -1.0) * lots * value * rate;
+	}
+}
+
+namespace mt4
+{
+	equity_engine::equity_engine()
+		: m_books(max_symbols)
+		, m_prices(max_symbols, std::array<double, 2>{ 0.0, 0.0 })
+	{
+	}
+
+	void equity_engine::clear()
+	{
+		std::lock_guard lock{ m_mutex };
+		for (auto& sides : m_books)
+		{
+			sides = {};
+		}
+		m_orders.clear();
+		m_slots.clear();
+		m_logins.clear();
+		m_base.clear();
+		m_floating.clear();
+		m_margin.clear();
+		m_margin_call.clear();
+		m_stop_out.clear();
+		m_currency_levels.clear();
+		m_levels.clear();
+		m_touched.clear();
+	}
+
+	void equity_engine::upsert(const trade_event& position, symbol_id id, const ConSymbol& symbol)
+	{
+		if ((position.cmd != OP_BUY && position.cmd != OP_SELL) || id >= max_symbols)
+		{
+			return;
+		}
+		std::lock_guard lock{ m_mutex };
+		if (const auto it = m_orders.find(position.order); it != m_orders.end())
+		{
+			erase_at(it->second);
+			m_orders.erase(it);
+		}
+
+		const auto slot = account_slot(position.login);
+		const uint8_t side = position.cmd == OP_BUY ? 0 : 1;
+		auto& target = m_books[id][side];
+		const auto multiplier = multiplier_of(position, symbol);
+		const auto price = m_prices[id][side];
+		// Until the symbol ticks, the server's own floating profit of the order stands in.
+		const auto profit = price > 0.0 ? multiplier * (price - position.open_price) : position.profit;
+
+		m_orders[position.order] = location{ id, side, static_cast<uint32_t>(target.order.size()) };
+		target.multiplier.push_back(multiplier);
+		target.open_price.push_back(position.open_price);
+		target.profit.push_back(profit);
+		target.account.push_back(slot);
+		target.order.push_back(position.order);
+		m_floating[slot] += profit;
+	}
+
+	void equity_engine::remove(int order)
+	{
+		std::lock_guard lock{ m_mutex };
+		if (const auto it = m_orders.find(order); it != m_orders.end())
+		{
+			erase_at(it->second);
+			m_orders.erase(it);
+		}
+	}
+
+	void equity_engine::anchor(int login, double equity, double margin, const ConGroup& group, std::vector<margin_alert>& alerts)
+	{
+		std::lock_guard lock{ m_mutex };
+		const auto slot = account_slot(login);
+		// The local floating profit stays in, so the next tick moves equity from the server's value.
+		m_base[slot] = equity - m_floating[slot];
+		m_margin[slot] = margin;
+		m_margin_call[slot] = group.margin_call;
+		m_stop_out[slot] = group.margin_stopout;
+		m_currency_levels[slot] = group.margin_type == MARGIN_TYPE_CURRENCY ? 1 : 0;
+		evaluate(slot, alerts);
+	}
+
+	void equity_engine::on_tick(symbol_id id, double bid, double ask, std::vector<margin_alert>& alerts)
+	{
+		if (id >= max_symbols)
+		{
+			return;
+		}
+		std::lock_guard lock{ m_mutex };
+		m_prices[id] = { bid, ask };
+		++m_ticks;
+		m_dirty.clear();
+
+		for (uint8_t side = 0; side < 2; ++side)
+		{
+			auto& positions = m_books[id][side];
+			const auto count = positions.profit.size();
+			if (count == 0)
+			{
+				continue;
+			}
+			const auto price = side == 0 ? bid : ask;
+
+			// Straight-line arithmetic over contiguous columns, the compiler turns it into SIMD.
+			m_scratch.resize(count);
+			const auto* multiplier = positions.multiplier.data();
+			const auto* open_price = positions.open_price.data();
+			auto* scratch = m_scratch.data();
+			for (size_t i = 0; i < count; ++i)
+			{
+				scratch[i] = multiplier[i] * (price - open_price[i]);
+			}
+
+			// The scatter into accounts can't be vectorized, it is kept apart from the loop above.
+			auto* profit = positions.profit.data();
+			const auto* account = positions.account.data();
+			for (size_t i = 0; i < count; ++i)
+			{
+				const auto slot = account[i];
+				m_floating[slot] += scratch[i] - profit[i];
+				profit[i] = scratch[i];
+				if (m_touched[slot] != m_ticks)
+				{
+					m_touched[slot] = m_ticks;
+					m_dirty.push_back(slot);
+				}
+			}
+		}
+
+		for (const auto slot : m_dirty)
+		{
+			evaluate(slot, alerts);
+		}
+	}
+
+	size_t equity_engine::positions() const
+	{
+		std::lock_guard lock{ m_mutex };
+		return m_orders.size();
+	}
+
+	size_t equity_engine::accounts() const
+	{
+		std::lock_guard lock{ m_mutex };
+		return m_logins.size();
+	}
+
+	uint32_t equity_engine::account_slot(int login)
+	{
+		if (const auto it = m_slots.find(login); it != m_slots.end())
+		{
+			return it->second;
+		}
+		const auto slot = static_cast<uint32_t>(m_logins.size());
+		m_slots.emplace(login, slot);
+		m_logins.push_back(login);
+		m_base.push_back(0.0);
+		m_floating.push_back(0.0);
+		m_margin.push_back(0.0);
+		m_margin_call.push_back(0.0);
+		m_stop_out.push_back(0.0);
+		m_currency_levels.push_back(0);
+		m_levels.push_back(margin_alert::OK);
+		m_touched.push_back(0);
+		return slot;
+	}
+
+	// Swaps the last position of the book into the hole.
+	void equity_engine::erase_at(const location& at)
+	{
+		auto& target = m_books[at.symbol][at.side];
+		m_floating[target.account[at.index]] -= target.profit[at.index];
+
+		const auto last = target.order.size() - 1;
+		if (at.index != last)
+		{
+			target.multiplier[at.index] = target.multiplier[last];
+			target.open_price[at.index] = target.open_price[last];
+			target.profit[at.index] = target.profit[last];
+			target.account[at.index] = target.account[last];
+			target.order[at.index] = target.order[last];
+			m_orders[target.order[at.index]].index = at.index;
+		}
+		target.multiplier.pop_back();
+		target.open_price.pop_back();
+		target.profit.pop_back();
+		target.account.pop_back();
+		target.order.pop_back();
+	}
+
+	void equity_engine::evaluate(uint32_t slot, std::vector<margin_alert>& alerts)
+	{
+		const auto equity = m_base[slot] + m_floating[slot];
+		const auto margin = m_margin[slot];
+		const auto margin_level = margin > 0.0 ? equity / margin * 100.0 : 0.0;
+
+		auto level = margin_alert::OK;
+		if (margin > 0.0)
+		{
+			const auto measure = m_currency_levels[slot] != 0 ? equity : margin_level;
+			if (measure <= m_stop_out[slot])
+			{
+				level = margin_alert::STOP_OUT;
+			}
+			else if (measure <= m_margin_call[slot])
+			{
+				level = margin_alert::MARGIN_CALL;
+			}
+		}
+		if (level != m_levels[slot])
+		{
+			m_levels[slot] = level;
+			alerts.push_back(margin_alert{ .login = m_logins[slot], .level = level, .equity = equity, .margin = margin, .margin_level = margin_level });
+		}
+	}
+}
\ No newline at end of file
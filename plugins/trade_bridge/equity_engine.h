@@ -0,0 +1,88 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "models.h"
+#include "registry.h"
+
+struct ConGroup;
+struct ConSymbol;
+
+namespace mt4
+{
+	// Floating profit and equity of every account with open positions, kept current tick by tick.
+	// Positions are stored per symbol and side as columns, so a tick recomputes one contiguous
+	// run of profits and adds the differences to the equity of the accounts they belong to.
+	//
+	// The server's own figures from TradesMarginGet anchor each account whenever its positions
+	// change; between anchors the equity moves with the raw quotes at the conversion rate of the
+	// open, which is what keeps a tick cheap.
+	class equity_engine
+	{
+	public:
+		equity_engine();
+
+		// Drops every position and account, before a reseed.
+		void clear();
+
+		// Positions come from the trade event publisher. Pending orders are ignored.
+		void upsert(const trade_event& position, symbol_id id, const ConSymbol& symbol);
+		void remove(int order);
+
+		// Server figures for one account, alerts are added when its level changed.
+		void anchor(int login, double equity, double margin, const ConGroup& group, std::vector<margin_alert>& alerts);
+
+		// Tick thread.
+		void on_tick(symbol_id id, double bid, double ask, std::vector<margin_alert>& alerts);
+
+		size_t positions() const;
+		size_t accounts() const;
+
+	private:
+		// Positions of one symbol and side. Buys are valued at the bid, sells at the ask with a
+		// negative multiplier, so both sides share profit = multiplier * (price - open_price).
+		struct book
+		{
+			std::vector<double>		multiplier;		// lots * contract value * conversion rate
+			std::vector<double>		open_price;
+			std::vector<double>		profit;			// as of the last tick
+			std::vector<uint32_t>	account;		// slot in the account columns
+			std::vector<int>		order;
+		};
+
+		struct location
+		{
+			symbol_id		symbol;
+			uint8_t			side;
+			uint32_t		index;
+		};
+
+		uint32_t account_slot(int login);
+		void erase_at(const location& at);
+		void evaluate(uint32_t slot, std::vector<margin_alert>& alerts);
+
+		mutable std::mutex							m_mutex;
+		std::vector<std::array<book, 2>>			m_books;		// by symbol id, buys then sells
+		std::vector<std::array<double, 2>>			m_prices;		// last bid and ask, 0 before the first tick
+		std::unordered_map<int, location>			m_orders;
+		std::vector<double>							m_scratch;		// new profits of the book being recomputed
+
+		// Accounts, by slot.
+		std::unordered_map<int, uint32_t>			m_slots;
+		std::vector<int>							m_logins;
+		std::vector<double>							m_base;			// equity without the floating profit
+		std::vector<double>							m_floating;
+		std::vector<double>							m_margin;
+		std::vector<double>							m_margin_call;
+		std::vector<double>							m_stop_out;
+		std::vector<uint8_t>						m_currency_levels;	// levels are money, not percent
+		std::vector<margin_alert::alert_level>		m_levels;
+		std::vector<uint64_t>						m_touched;		// tick that last touched the account
+		uint64_t									m_ticks{ 0 };
+		std::vector<uint32_t>						m_dirty;
+	};
+}
\ No newline at end of file
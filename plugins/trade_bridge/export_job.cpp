@@ -0,0 +1,300 @@
+#include "export_job.h"
+
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+
+#include <fmt/core.h>
+#include <zlib.h>
+
+#include "json.h"
+
+#include "mt4.h"
+
+namespace
+{
+	template<size_t Size>
+	std::string_view bounded(const char (&name)[Size]) noexcept
+	{
+		return std::string_view{ name, strnlen(name, Size) };
+	}
+
+	class dictionary
+	{
+	public:
+		uint32_t index_of(const std::string_view value)
+		{
+			auto [it, inserted] = m_indexes.try_emplace(std::string{ value }, static_cast<uint32_t>(m_values.size()));
+			if (inserted)
+			{
+				m_values.emplace_back(value);
+			}
+			return it->second;
+		}
+
+		const std::vector<std::string>& values() const { return m_values; }
+
+	private:
+		std::unordered_map<std::string, uint32_t>	m_indexes;
+		std::vector<std::string>					m_values;
+	};
+
+	json::type header(const mt4::export_job& job, uint64_t slice, size_t rows)
+	{
+		const auto logins = job.logins(slice);
+		json::type document
+		{
+			{ "export_id",		job.request().export_id },
+			{ "kind",			job.request().kind == mt4::export_request::USERS ? "users" : "closed_trades" },
+			{ "slice",			slice },
+			{ "slices",			job.slices() },
+			{ "first_login",	logins.empty() ? 0 : logins.front() },
+			{ "last_login",		logins.empty() ? 0 : logins.back() },
+			{ "window",			job.window_index(slice) },
+			{ "rows",			rows },
+		};
+		if (job.request().kind == mt4::export_request::CLOSED_TRADES)
+		{
+			const auto [from, to] = job.window(slice);
+			document["from"] = from;
+			document["to"] = to;
+		}
+		return document;
+	}
+
+	tl::expected<std::string, std::string> pack(const json::type& document)
+	{
+		const auto packed = json::type::to_msgpack(document);
+
+		uLongf compressed_size = compressBound(static_cast<uLong>(packed.size()));
+		std::string compressed(compressed_size, '\0');
+		if (auto status = compress2(reinterpret_cast<Bytef*>(compressed.data()), &compressed_size,
+			packed.data(), static_cast<uLong>(packed.size()), Z_BEST_SPEED); status != Z_OK)
+		{
+			return tl::unexpected{ std::string{ "Failed to compress export chunk: " } + zError(status) };
+		}
+		compressed.resize(compressed_size);
+		return compressed;
+	}
+}
+
+namespace mt4
+{
+	export_job::export_job(export_request&& request, std::string_view reply_to, std::vector<int>&& logins,
+		std::chrono::steady_clock::time_point started)
+		: m_request{ std::move(request) }
+		, m_reply_to{ reply_to }
+		, m_logins{ std::move(logins) }
+		, m_started{ started }
+		, m_windows{ windows(m_request) }
+		, m_slices{ (m_logins.size() + m_request.logins_per_slice - 1) / m_request.logins_per_slice * m_windows }
+		, m_next{ 0 }
+		, m_done(m_slices, false)
+		, m_cursor{ 0 }
+	{
+	}
+
+	uint64_t export_job::windows(const export_request& request) noexcept
+	{
+		return request.kind == export_request::USERS || request.to < request.from ? 1
+			: static_cast<uint64_t>((request.to - request.from) / request.slice_seconds + 1);
+	}
+
+	bool export_job::next(uint64_t& slice) noexcept
+	{
+		std::lock_guard lock{ m_mutex };
+		if (!m_error.empty() || m_next >= m_slices)
+		{
+			return false;
+		}
+		slice = m_next++;
+		++m_issued;
+		return true;
+	}
+
+	std::span<const int> export_job::logins(uint64_t slice) const noexcept
+	{
+		const auto first = static_cast<size_t>(slice / m_windows) * m_request.logins_per_slice;
+		if (first >= m_logins.size())
+		{
+			return {};
+		}
+		return std::span<const int>{ m_logins }.subspan(first, std::min(m_request.logins_per_slice, m_logins.size() - first));
+	}
+
+	uint64_t export_job::window_index(uint64_t slice) const noexcept
+	{
+		return slice % m_windows;
+	}
+
+	std::pair<int64_t, int64_t> export_job::window(uint64_t slice) const noexcept
+	{
+		const auto from = m_request.from + static_cast<int64_t>(window_index(slice)) * m_request.slice_seconds;
+		return { from, std::min(from + m_request.slice_seconds - 1, m_request.to) };
+	}
+
+	bool export_job::complete(uint64_t slice, size_t rows)
+	{
+		m_rows.fetch_add(rows, std::memory_order_relaxed);
+		std::lock_guard lock{ m_mutex };
+		m_done[slice] = true;
+		while (m_cursor < m_slices && m_done[m_cursor])
+		{
+			++m_cursor;
+		}
+		++m_finished;
+		return m_finished == m_issued && (m_next >= m_slices || !m_error.empty());
+	}
+
+	bool export_job::fail(uint64_t slice, std::string&& error)
+	{
+		std::lock_guard lock{ m_mutex };
+		if (m_error.empty())
+		{
+			m_error = fmt::format("Slice {}: {}", slice, error);
+		}
+		++m_finished;
+		return m_finished == m_issued;
+	}
+
+	export_progress export_job::progress() const
+	{
+		std::lock_guard lock{ m_mutex };
+		// The last login of the leading login slices with every window done.
+		const auto login_slices = static_cast<size_t>(m_cursor / m_windows);
+		const auto cursor_login = login_slices == 0 ? m_request.resume_login
+			: m_logins[std::min(login_slices * m_request.logins_per_slice, m_logins.size()) - 1];
+		return export_progress{
+			.export_id = m_request.export_id,
+			.finished = m_finished == m_issued && (m_next >= m_slices || !m_error.empty()),
+			.reject_code = m_error.empty() ? RET_OK : RET_ERROR,
+			.reject_message = m_error,
+			.slices = m_slices,
+			.cursor_login = cursor_login,
+			.rows = m_rows.load(std::memory_order_relaxed),
+		};
+	}
+
+	tl::expected<std::string, std::string> encode_users(const export_job& job, uint64_t slice, std::span<const UserRecord> users)
+	{
+		dictionary groups{};
+		std::vector<int> login{}, group{}, leverage{}, enable{}, read_only{}, agent_account{};
+		std::vector<int64_t> regdate{}, lastdate{};
+		std::vector<double> balance{}, prevbalance{}, prevmonthbalance{}, credit{}, prevequity{}, prevmonthequity{};
+		std::vector<std::string> name{}, country{}, city{}, email{}, status{}, comment{};
+		for (const auto& user : users)
+		{
+			login.push_back(user.login);
+			group.push_back(static_cast<int>(groups.index_of(bounded(user.group))));
+			leverage.push_back(user.leverage);
+			enable.push_back(user.enable);
+			read_only.push_back(user.enable_read_only);
+			agent_account.push_back(user.agent_account);
+			regdate.push_back(user.regdate);
+			lastdate.push_back(user.lastdate);
+			balance.push_back(user.balance);
+			prevbalance.push_back(user.prevbalance);
+			prevmonthbalance.push_back(user.prevmonthbalance);
+			credit.push_back(user.credit);
+			prevequity.push_back(user.prevequity);
+			prevmonthequity.push_back(user.prevmonthequity);
+			name.emplace_back(bounded(user.name));
+			country.emplace_back(bounded(user.country));
+			city.emplace_back(bounded(user.city));
+			email.emplace_back(bounded(user.email));
+			status.emplace_back(bounded(user.status));
+			comment.emplace_back(bounded(user.comment));
+		}
+
+		auto document = header(job, slice, users.size());
+		document["groups"] = groups.values();
+		document["columns"] = json::type
+		{
+			{ "login",				login },
+			{ "group",				group },
+			{ "name",				name },
+			{ "country",			country },
+			{ "city",				city },
+			{ "email",				email },
+			{ "status",				status },
+			{ "comment",			comment },
+			{ "leverage",			leverage },
+			{ "enable",				enable },
+			{ "enable_read_only",	read_only },
+			{ "agent_account",		agent_account },
+			{ "regdate",			regdate },
+			{ "lastdate",			lastdate },
+			{ "balance",			balance },
+			{ "prevbalance",		prevbalance },
+			{ "prevmonthbalance",	prevmonthbalance },
+			{ "credit",				credit },
+			{ "prevequity",			prevequity },
+			{ "prevmonthequity",	prevmonthequity },
+		};
+		return pack(document);
+	}
+
+	tl::expected<std::string, std::string> encode_closed_trades(const export_job& job, uint64_t slice, std::span<const TradeRecord> trades)
+	{
+		dictionary symbols{};
+		std::vector<int> order{}, login{}, symbol{}, digits{}, cmd{}, volume{}, reason{}, magic{};
+		std::vector<int64_t> open_time{}, close_time{};
+		std::vector<double> open_price{}, close_price{}, sl{}, tp{}, commission{}, commission_agent{}, storage{}, taxes{}, profit{},
+			open_rate{}, close_rate{};
+		std::vector<std::string> comment{};
+		for (const auto& trade : trades)
+		{
+			order.push_back(trade.order);
+			login.push_back(trade.login);
+			symbol.push_back(static_cast<int>(symbols.index_of(bounded(trade.symbol))));
+			digits.push_back(trade.digits);
+			cmd.push_back(trade.cmd);
+			volume.push_back(trade.volume);
+			reason.push_back(trade.reason);
+			magic.push_back(trade.magic);
+			open_time.push_back(trade.open_time);
+			close_time.push_back(trade.close_time);
+			open_price.push_back(trade.open_price);
+			close_price.push_back(trade.close_price);
+			sl.push_back(trade.sl);
+			tp.push_back(trade.tp);
+			commission.push_back(trade.commission);
+			commission_agent.push_back(trade.commission_agent);
+			storage.push_back(trade.storage);
+			taxes.push_back(trade.taxes);
+			profit.push_back(trade.profit);
+			open_rate.push_back(trade.conv_rates[0]);
+			close_rate.push_back(trade.conv_rates[1]);
+			comment.emplace_back(bounded(trade.comment));
+		}
+
+		auto document = header(job, slice, trades.size());
+		document["symbols"] = symbols.values();
+		document["columns"] = json::type
+		{
+			{ "order",				order },
+			{ "login",				login },
+			{ "symbol",				symbol },
+			{ "digits",				digits },
+			{ "cmd",				cmd },
+			{ "volume",				volume },
+			{ "open_time",			open_time },
+			{ "open_price",			open_price },
+			{ "sl",					sl },
+			{ "tp",					tp },
+			{ "close_time",			close_time },
+			{ "close_price",		close_price },
+			{ "commission",			commission },
+			{ "commission_agent",	commission_agent },
+			{ "storage",			storage },
+			{ "taxes",				taxes },
+			{ "profit",				profit },
+			{ "conv_rate_open",		open_rate },
+			{ "conv_rate_close",	close_rate },
+			{ "reason",				reason },
+			{ "magic",				magic },
+			{ "comment",			comment },
+		};
+		return pack(document);
+	}
+}
\ No newline at end of file
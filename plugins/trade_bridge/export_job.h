@@ -0,0 +1,83 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <tl/expected.hpp>
+
+#include "models.h"
+
+struct TradeRecord;
+struct UserRecord;
+
+namespace mt4
+{
+	// One bulk export in progress. Its slices are handed to the pool a window at a time like the
+	// targets of a mass operation, each slice becomes one compressed chunk of columns.
+	class export_job
+	{
+	public:
+		using ptr_t = std::shared_ptr<export_job>;
+
+		// Logins sorted and past resume_login, the request's slice sizes already clamped.
+		export_job(export_request&& request, std::string_view reply_to, std::vector<int>&& logins,
+			std::chrono::steady_clock::time_point started);
+
+		// Time slices per login slice.
+		static uint64_t windows(const export_request& request) noexcept;
+
+		export_job(const export_job&) = delete;
+		export_job& operator= (const export_job&) = delete;
+
+		// False once every slice was handed out.
+		bool next(uint64_t& slice) noexcept;
+
+		std::span<const int> logins(uint64_t slice) const noexcept;
+		// Index of the slice's time range, counted from the request's from like the cursor.
+		uint64_t window_index(uint64_t slice) const noexcept;
+		// Close time range of a closed orders slice, inclusive.
+		std::pair<int64_t, int64_t> window(uint64_t slice) const noexcept;
+
+		// True for the call that finishes the last slice. A failed slice fails the export,
+		// the cursor stays in front of it.
+		bool complete(uint64_t slice, size_t rows);
+		bool fail(uint64_t slice, std::string&& error);
+
+		export_progress progress() const;
+
+		const export_request& request() const noexcept { return m_request; }
+		uint64_t slices() const noexcept { return m_slices; }
+		const std::string& reply_to() const noexcept { return m_reply_to; }
+		std::chrono::steady_clock::time_point started() const noexcept { return m_started; }
+
+	private:
+		const export_request		m_request;
+		const std::string			m_reply_to;
+		const std::vector<int>		m_logins;
+		const std::chrono::steady_clock::time_point m_started;
+		const uint64_t				m_windows;		// time slices per login slice
+		const uint64_t				m_slices;
+
+		std::atomic<uint64_t>		m_rows{ 0 };
+
+		mutable std::mutex			m_mutex;
+		uint64_t					m_next;
+		std::vector<bool>			m_done;
+		uint64_t					m_cursor;		// leading slices done
+		uint64_t					m_issued{ 0 };
+		uint64_t					m_finished{ 0 };
+		std::string					m_error;
+	};
+
+	// A slice as a zlib-compressed MessagePack document with one array per field, strings that
+	// repeat across rows (groups, symbols) are stored once and referenced by index.
+	tl::expected<std::string, std::string> encode_users(const export_job& job, uint64_t slice, std::span<const UserRecord> users);
+	tl::expected<std::string, std::string> encode_closed_trades(const export_job& job, uint64_t slice, std::span<const TradeRecord> trades);
+}
\ No newline at end of file
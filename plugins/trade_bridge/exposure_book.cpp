@@ -0,0 +1,178 @@
+#include "exposure_book.h"
+
+#include "config_store.h"
+
+#include "mt4.h"
+
+namespace mt4
+{
+	exposure_book::exposure_book()
+		: m_symbols(max_symbols)
+		, m_groups(max_symbols)
+		, m_prices(max_symbols, 0.0)
+	{
+	}
+
+	void exposure_book::clear()
+	{
+		std::lock_guard lock{ m_mutex };
+		// Symbols that had volume report their drop to zero with the next update.
+		for (size_t id = 0; id < max_symbols; ++id)
+		{
+			if (!m_symbols[id].empty())
+			{
+				m_changed.set(id);
+			}
+			m_symbols[id] = {};
+			m_groups[id].clear();
+		}
+		m_orders.clear();
+	}
+
+	void exposure_book::upsert(const trade_event& order, symbol_id symbol, group_id group)
+	{
+		std::lock_guard lock{ m_mutex };
+		if (const auto it = m_orders.find(order.order); it != m_orders.end())
+		{
+			apply(it->second, -1);
+			m_orders.erase(it);
+		}
+		if ((order.cmd != OP_BUY && order.cmd != OP_SELL) || symbol >= max_symbols)
+		{
+			return;
+		}
+		const contribution entry{ .symbol = symbol, .group = group, .buy = order.cmd == OP_BUY, .volume = order.volume };
+		apply(entry, 1);
+		m_orders.emplace(order.order, entry);
+	}
+
+	void exposure_book::remove(int order)
+	{
+		std::lock_guard lock{ m_mutex };
+		if (const auto it = m_orders.find(order); it != m_orders.end())
+		{
+			apply(it->second, -1);
+			m_orders.erase(it);
+		}
+	}
+
+	void exposure_book::on_tick(symbol_id symbol, double bid, double ask)
+	{
+		if (symbol >= max_symbols)
+		{
+			return;
+		}
+		std::lock_guard lock{ m_mutex };
+		m_prices[symbol] = (bid + ask) / 2.0;
+		if (!m_symbols[symbol].empty())
+		{
+			m_changed.set(symbol);
+		}
+	}
+
+	exposure_update exposure_book::take_changed(const config_view& view, const registry& names)
+	{
+		std::lock_guard lock{ m_mutex };
+		exposure_update update{ .sequence = ++m_sequence, .exposures = {} };
+		m_changed.for_each([&](size_t id)
+		{
+			collect(view, names, static_cast<symbol_id>(id), invalid_id, true, update.exposures);
+			return true;
+		});
+		m_changed = {};
+		return update;
+	}
+
+	bool exposure_book::changed() const
+	{
+		std::lock_guard lock{ m_mutex };
+		return m_changed.count() != 0;
+	}
+
+	exposure_update exposure_book::snapshot(const config_view& view, const registry& names, const exposure_request& request) const
+	{
+		const auto symbol = request.symbol.empty() ? invalid_id : names.symbols.find(request.symbol);
+		const auto group = request.group.empty() ? invalid_id : names.groups.find(request.group);
+
+		std::lock_guard lock{ m_mutex };
+		exposure_update result{ .sequence = m_sequence, .exposures = {} };
+		if ((!request.symbol.empty() && symbol == invalid_id) || (!request.group.empty() && group == invalid_id))
+		{
+			return result;
+		}
+		const auto first = symbol == invalid_id ? symbol_id{ 0 } : symbol;
+		const auto last = symbol == invalid_id ? static_cast<symbol_id>(max_symbols) : static_cast<symbol_id>(symbol + 1);
+		for (auto id = first; id < last; ++id)
+		{
+			if (!m_symbols[id].empty())
+			{
+				collect(view, names, id, group, request.group.empty(), result.exposures);
+			}
+		}
+		return result;
+	}
+
+	size_t exposure_book::orders() const
+	{
+		std::lock_guard lock{ m_mutex };
+		return m_orders.size();
+	}
+
+	void exposure_book::apply(const contribution& entry, int sign)
+	{
+		const auto volume = static_cast<int64_t>(sign) * entry.volume;
+		auto& total = m_symbols[entry.symbol];
+		(entry.buy ? total.long_volume : total.short_volume) += volume;
+		m_changed.set(entry.symbol);
+		// Accounts of groups missing from the configuration count in the totals only.
+		if (entry.group == invalid_id)
+		{
+			return;
+		}
+		auto& group = m_groups[entry.symbol][entry.group];
+		(entry.buy ? group.long_volume : group.short_volume) += volume;
+		if (group.empty())
+		{
+			m_groups[entry.symbol].erase(entry.group);
+		}
+	}
+
+	// Appends the symbol's totals and its groups, or the one group asked for.
+	void exposure_book::collect(const config_view& view, const registry& names, symbol_id symbol, group_id group, bool totals_too,
+		std::vector<symbol_exposure>& out) const
+	{
+		const auto config = view.symbol(symbol);
+		const auto price = m_prices[symbol];
+		const auto notional = (config != nullptr ? config->contract_size : 0.0) * price / 100.0;
+		const auto make = [&](const totals& figures, std::string_view group_name)
+		{
+			return symbol_exposure{
+				.symbol = std::string{ names.symbols.name(symbol) },
+				.group = std::string{ group_name },
+				.long_volume = figures.long_volume / 100.0,
+				.short_volume = figures.short_volume / 100.0,
+				.long_notional = figures.long_volume * notional,
+				.short_notional = figures.short_volume * notional,
+				.price = price,
+			};
+		};
+
+		if (totals_too)
+		{
+			out.push_back(make(m_symbols[symbol], {}));
+		}
+		const auto& groups = m_groups[symbol];
+		if (group != invalid_id)
+		{
+			if (const auto it = groups.find(group); it != groups.end())
+			{
+				out.push_back(make(it->second, names.groups.name(group)));
+			}
+			return;
+		}
+		for (const auto& [id, figures] : groups)
+		{
+			out.push_back(make(figures, names.groups.name(id)));
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "models.h"
+#include "registry.h"
+
+namespace mt4
+{
+	class config_view;
+
+	// Net long and short volume of every symbol, in total and per group, kept as running sums:
+	// an order event moves the sums by the order's old and new volume, so nothing rescans the book.
+	// Notionals are derived when an update is taken, from the contract size of the symbol cache
+	// and the last mid price, and ticks only mark their symbol as changed.
+	class exposure_book
+	{
+	public:
+		exposure_book();
+
+		void clear();
+
+		// Publisher. Pending orders and orders of unknown symbols count as no exposure,
+		// orders of an unknown group count in the symbol's totals only.
+		void upsert(const trade_event& order, symbol_id symbol, group_id group);
+		void remove(int order);
+
+		// Tick thread.
+		void on_tick(symbol_id symbol, double bid, double ask);
+
+		// Symbols changed since the previous call, with their groups, for the throttled stream.
+		exposure_update take_changed(const config_view& view, const registry& names);
+		bool changed() const;
+
+		// Totals and groups, narrowed by the request's symbol and group.
+		exposure_update snapshot(const config_view& view, const registry& names, const exposure_request& request) const;
+
+		size_t orders() const;
+
+	private:
+		// Volumes in hundredths of a lot as the server keeps them, so the sums stay exact.
+		struct totals
+		{
+			int64_t		long_volume{ 0 };
+			int64_t		short_volume{ 0 };
+
+			bool empty() const noexcept { return long_volume == 0 && short_volume == 0; }
+		};
+
+		struct contribution
+		{
+			symbol_id	symbol;
+			group_id	group;
+			bool		buy;
+			int			volume;
+		};
+
+		void apply(const contribution& entry, int sign);
+		void collect(const config_view& view, const registry& names, symbol_id symbol, group_id group, bool totals_too,
+			std::vector<symbol_exposure>& out) const;
+
+		mutable std::mutex										m_mutex;
+		std::vector<totals>										m_symbols;		// by symbol id
+		std::vector<std::unordered_map<group_id, totals>>		m_groups;		// by symbol id, groups with volume only
+		std::vector<double>										m_prices;		// mid, by symbol id
+		std::unordered_map<int, contribution>					m_orders;
+		symbol_set												m_changed;
+		uint64_t												m_sequence{ 0 };
+	};
+}
\ No newline at end of file
@@ -0,0 +1,109 @@
+#include "idempotency_store.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+namespace
+{
+	// splitmix64 finalizer, consecutive request ids of one login spread over all stripes.
+	uint64_t mix(uint64_t value) noexcept
+	{
+		value ^= value >> 30;
+		value *= 0xBF58476D1CE4E5B9ull;
+		value ^= value >> 27;
+		value *= 0x94D049BB133111EBull;
+		return value ^ (value >> 31);
+	}
+}
+
+namespace mt4
+{
+	idempotency_store::idempotency_store(size_t memory_bytes, std::chrono::seconds ttl)
+		: m_ttl{ std::chrono::duration_cast<clock_t::duration>(ttl).count() }
+	{
+		const auto per_stripe = std::max<size_t>(memory_bytes / sizeof(entry) / stripes_total, probe_limit);
+		m_mask = std::bit_floor(per_stripe) - 1;
+		for (auto& stripe : m_stripes)
+		{
+			stripe.entries.reset(new entry[m_mask + 1]{});
+		}
+	}
+
+	std::optional<trade_response> idempotency_store::find(int login, int request_id, clock_t::time_point now)
+	{
+		const auto key = key_of(login, request_id);
+		const auto hash = mix(key);
+		auto& stripe = m_stripes[hash >> 60];
+
+		std::lock_guard lock{ stripe.mutex };
+		for (size_t i = 0; i < probe_limit; ++i)
+		{
+			const auto& slot = stripe.entries[(hash + i) & m_mask];
+			if (!slot.used)
+			{
+				break;
+			}
+			if (slot.key == key && is_live(slot, now))
+			{
+				return trade_response{
+					.request_id = request_id,
+					.order_id = slot.order_id,
+					.reject_code = slot.reject_code,
+					.reject_message = slot.message
+				};
+			}
+		}
+		return std::nullopt;
+	}
+
+	void idempotency_store::store(int login, const trade_response& response, clock_t::time_point now)
+	{
+		const auto key = key_of(login, response.request_id);
+		const auto hash = mix(key);
+		auto& stripe = m_stripes[hash >> 60];
+
+		std::lock_guard lock{ stripe.mutex };
+		// Slots are never emptied again, so lookups can stop at the first empty one;
+		// expired slots are reused instead.
+		entry* target{ nullptr };
+		entry* oldest{ nullptr };
+		for (size_t i = 0; i < probe_limit; ++i)
+		{
+			auto& slot = stripe.entries[(hash + i) & m_mask];
+			if (!slot.used || slot.key == key || !is_live(slot, now))
+			{
+				target = &slot;
+				break;
+			}
+			if (oldest == nullptr || slot.stored_at < oldest->stored_at)
+			{
+				oldest = &slot;
+			}
+		}
+		if (target == nullptr)
+		{
+			target = oldest;
+			m_evicted.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		target->key = key;
+		target->used = true;
+		target->order_id = response.order_id;
+		target->reject_code = response.reject_code;
+		target->stored_at = now.time_since_epoch().count();
+		const auto size = std::min(response.reject_message.size(), message_size - 1);
+		std::memcpy(target->message, response.reject_message.data(), size);
+		target->message[size] = '\0';
+	}
+
+	uint64_t idempotency_store::key_of(int login, int request_id) noexcept
+	{
+		return (uint64_t{ static_cast<uint32_t>(login) } << 32) | static_cast<uint32_t>(request_id);
+	}
+
+	bool idempotency_store::is_live(const entry& slot, clock_t::time_point now) const noexcept
+	{
+		return now.time_since_epoch().count() - slot.stored_at < m_ttl;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+
+#include "models.h"
+
+namespace mt4
+{
+	// Remembers the responses of recent trade requests, so a request retried by its sender
+	// gets the first answer instead of a second order. Memory is allocated once: a lookup
+	// probes at most probe_limit slots of one stripe, and when those are all live the oldest
+	// entry is overwritten. Keys are login and request id, so clients can't collide.
+	class idempotency_store
+	{
+		static constexpr size_t stripes_total = 16;
+		static constexpr size_t probe_limit = 16;
+		static constexpr size_t message_size = 96;
+
+		using clock_t = std::chrono::steady_clock;
+
+		struct entry
+		{
+			uint64_t		key;			// any value, login 0 with request id 0 included
+			bool			used;			// false for a slot never used
+			int				order_id;
+			int				reject_code;
+			clock_t::rep	stored_at;
+			char			message[message_size];
+		};
+
+		struct stripe
+		{
+			std::mutex					mutex;
+			std::unique_ptr<entry[]>	entries;
+		};
+
+	public:
+		// Capacity is memory_bytes / sizeof(entry), rounded down to a power of two per stripe.
+		idempotency_store(size_t memory_bytes, std::chrono::seconds ttl);
+
+		idempotency_store(const idempotency_store&) = delete;
+		idempotency_store& operator= (const idempotency_store&) = delete;
+
+		std::optional<trade_response> find(int login, int request_id, clock_t::time_point now);
+		void store(int login, const trade_response& response, clock_t::time_point now);
+
+		size_t capacity() const noexcept { return (m_mask + 1) * stripes_total; }
+
+		// Live entries overwritten before their expiry, a sign that the memory cap is too low.
+		uint64_t evicted() noexcept { return m_evicted.exchange(0, std::memory_order_relaxed); }
+
+	private:
+		static uint64_t key_of(int login, int request_id) noexcept;
+
+		bool is_live(const entry& slot, clock_t::time_point now) const noexcept;
+
+		const clock_t::rep			m_ttl;
+		size_t						m_mask{ 0 };
+		std::array<stripe, stripes_total>	m_stripes;
+		std::atomic<uint64_t>		m_evicted{ 0 };
+	};
+}
\ No newline at end of file
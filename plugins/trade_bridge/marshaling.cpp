@@ -3,6 +3,8 @@
 #include "mt4.h"
 #include "models.h"
 
+#include <stdexcept>
+
 json_t to_json(const FeedTick& tick)
 {
 	return json_t
@@ -51,26 +53,419 @@ namespace mt4
 			{ "swap_short",		s.swap_short },
 			{ "lot_min",		s.lot_min },
 			{ "lot_max",		s.lot_max },
-			{ "lot_step",		s.lot_step }
+			{ "lot_step",		s.lot_step },
+			{ "version",		s.version }
 		};
 	}
 
-	NLOHMANN_JSON_SERIALIZE_ENUM(trade_request::order_side, {
-		{trade_request::order_side::BUY, "buy"},
-		{trade_request::order_side::SELL, "sell"},
-	});
+	json_t to_json(const symbols_ready& r)
+	{
+		return json_t
+		{
+			{ "version",	r.version },
+			{ "groups",		r.groups },
+			{ "published",	r.published },
+			{ "elapsed_ms",	r.elapsed_ms },
+		};
+	}
 
-	trade_request from_json(const json_t& j)
+	// Type and side are accepted as names or as their numbers. An unknown value must fail
+	// the request rather than fall back to a default. Without a type, a ticket means CLOSE.
+	void from_json(const json_t& j, trade_request& req)
 	{
-		trade_request req;
-		j.at("id").get_to(req.request_id);
-		j.at("side").get_to(req.side);
+		j.at("request_id").get_to(req.request_id);
 		j.at("login").get_to(req.login);
+		req.order = j.value("order", 0);
+		req.sl = j.value("sl", 0.0);
+		req.tp = j.value("tp", 0.0);
+		req.volume = j.value("volume", 0.0);
+		req.comment = j.value("comment", std::string{});
+		req.symbol = j.value("symbol", std::string{});
+		req.side = trade_request::BUY;
+
+		const auto type = j.value("type", json_t(req.order != 0 ? "close" : "new"));
+		if (type == "new" || type == 0)
+		{
+			req.type = trade_request::NEW;
+		}
+		else if (type == "close" || type == 1)
+		{
+			req.type = trade_request::CLOSE;
+		}
+		else if (type == "cancel" || type == 2)
+		{
+			req.type = trade_request::CANCEL;
+		}
+		else if (type == "modify" || type == 3)
+		{
+			req.type = trade_request::MODIFY;
+		}
+		else
+		{
+			throw std::invalid_argument("invalid type");
+		}
+
+		if (req.type != trade_request::NEW)
+		{
+			if (req.order == 0)
+			{
+				throw std::invalid_argument("order is required");
+			}
+			return;
+		}
+		const auto& side = j.at("side");
+		if (side == "buy" || side == 0)
+		{
+			req.side = trade_request::BUY;
+		}
+		else if (side == "sell" || side == 1)
+		{
+			req.side = trade_request::SELL;
+		}
+		else
+		{
+			throw std::invalid_argument("invalid side");
+		}
 		j.at("volume").get_to(req.volume);
-		j.at("sl").get_to(req.sl);
-		j.at("tp").get_to(req.tp);
 		j.at("symbol").get_to(req.symbol);
-		j.at("comment").get_to(req.comment);
-		return req;
 	}
-}
+
+	json_t to_json(const trade_response& r)
+	{
+		return json_t
+		{
+			{ "request_id",		r.request_id },
+			{ "order_id",		r.order_id },
+			{ "reject_code",	r.reject_code },
+			{ "reject_message",	r.reject_message },
+		};
+	}
+	void from_json(const json_t& j, trade_basket& basket)
+	{
+		j.at("basket_id").get_to(basket.basket_id);
+		const auto& legs = j.at("legs");
+		if (!legs.is_array() || legs.empty())
+		{
+			throw std::invalid_argument("legs must be a non-empty array");
+		}
+		basket.legs.resize(legs.size());
+		for (size_t i = 0; i < legs.size(); ++i)
+		{
+			from_json(legs[i], basket.legs[i]);
+		}
+	}
+
+	json_t to_json(const trade_basket_response& r)
+	{
+		auto legs = json_t::array();
+		for (const auto& leg : r.legs)
+		{
+			legs.push_back(to_json(leg));
+		}
+		return json_t
+		{
+			{ "basket_id",		r.basket_id },
+			{ "reject_code",	r.reject_code },
+			{ "reject_message",	r.reject_message },
+			{ "legs",			std::move(legs) },
+		};
+	}
+
+	void from_json(const json_t& j, mass_trade_request& req)
+	{
+		j.at("operation_id").get_to(req.operation_id);
+		const auto& action = j.at("action");
+		if (action == "close")
+		{
+			req.action = mass_trade_request::CLOSE;
+		}
+		else if (action == "cancel")
+		{
+			req.action = mass_trade_request::CANCEL;
+		}
+		else if (action == "modify")
+		{
+			req.action = mass_trade_request::MODIFY;
+		}
+		else
+		{
+			throw std::invalid_argument("invalid action");
+		}
+		req.groups = j.value("groups", std::string{ "*" });
+		req.logins = j.value("logins", std::vector<int>{});
+		req.symbol = j.value("symbol", std::string{});
+		req.comment = j.value("comment", std::string{});
+		if (j.contains("sl"))
+		{
+			req.sl = j.at("sl").get<double>();
+		}
+		if (j.contains("tp"))
+		{
+			req.tp = j.at("tp").get<double>();
+		}
+		if (req.action == mass_trade_request::MODIFY && !req.sl && !req.tp)
+		{
+			throw std::invalid_argument("modify requires sl or tp");
+		}
+	}
+
+	json_t to_json(const mass_trade_progress& p)
+	{
+		auto failures = json_t::array();
+		for (const auto& failure : p.failures)
+		{
+			failures.push_back(json_t
+			{
+				{ "login",			failure.login },
+				{ "order",			failure.order },
+				{ "reject_code",	failure.reject_code },
+				{ "reject_message",	failure.reject_message },
+			});
+		}
+		return json_t
+		{
+			{ "operation_id",	p.operation_id },
+			{ "finished",		p.finished },
+			{ "reject_code",	p.reject_code },
+			{ "reject_message",	p.reject_message },
+			{ "targets",		p.targets },
+			{ "done",			p.done },
+			{ "failed",			p.failed },
+			{ "failures",		std::move(failures) },
+		};
+	}
+
+	NLOHMANN_JSON_SERIALIZE_ENUM(trade_event::event_kind, {
+		{trade_event::OPENED, "opened"},
+		{trade_event::MODIFIED, "modified"},
+		{trade_event::ACTIVATED, "activated"},
+		{trade_event::CLOSED, "closed"},
+		{trade_event::DELETED, "deleted"},
+		{trade_event::CLOSED_BY, "closed_by"},
+	});
+
+	namespace
+	{
+		// Order fields shared by trade events and open positions.
+		json_t order_fields(const trade_event& e)
+		{
+			return json_t
+			{
+				{ "order",			e.order },
+				{ "login",			e.login },
+				{ "symbol",			e.symbol },
+				{ "cmd",			e.cmd },
+				{ "volume",			e.volume },
+				{ "state",			e.state },
+				{ "open_time",		e.open_time },
+				{ "open_price",		e.open_price },
+				{ "sl",				e.sl },
+				{ "tp",				e.tp },
+				{ "close_time",		e.close_time },
+				{ "close_price",	e.close_price },
+				{ "profit",			e.profit },
+				{ "commission",		e.commission },
+				{ "storage",		e.storage },
+				{ "comment",		e.comment },
+				{ "timestamp",		e.timestamp },
+			};
+		}
+	}
+
+	json_t to_json(const trade_event_batch& b)
+	{
+		auto events = json_t::array();
+		for (const auto& e : b.events)
+		{
+			auto event = order_fields(e);
+			event["sequence"] = e.sequence;
+			event["kind"] = e.kind;
+			events.push_back(std::move(event));
+		}
+		return json_t
+		{
+			{ "epoch",		b.epoch },
+			{ "dropped",	b.dropped },
+			{ "events",		std::move(events) },
+		};
+	}
+
+	void from_json(const json_t& j, positions_request& req)
+	{
+		req.login = j.value("login", 0);
+		req.after = j.value("after", 0);
+		req.limit = j.value("limit", size_t{ 1000 });
+	}
+
+	json_t to_json(const positions_page& p)
+	{
+		auto positions = json_t::array();
+		for (const auto& position : p.positions)
+		{
+			positions.push_back(order_fields(position));
+		}
+		return json_t
+		{
+			{ "epoch",		p.epoch },
+			{ "sequence",	p.sequence },
+			{ "next",		p.next },
+			{ "positions",	std::move(positions) },
+		};
+	}
+
+	json_t to_json(const position_deltas& d)
+	{
+		auto deltas = json_t::array();
+		for (const auto& delta : d.deltas)
+		{
+			auto entry = order_fields(delta.position);
+			entry["sequence"] = delta.sequence;
+			entry["removed"] = delta.removed;
+			deltas.push_back(std::move(entry));
+		}
+		return json_t
+		{
+			{ "epoch",		d.epoch },
+			{ "deltas",		std::move(deltas) },
+		};
+	}
+
+	NLOHMANN_JSON_SERIALIZE_ENUM(margin_alert::alert_level, {
+		{margin_alert::OK, "ok"},
+		{margin_alert::MARGIN_CALL, "margin_call"},
+		{margin_alert::STOP_OUT, "stop_out"},
+	});
+
+	json_t to_json(const margin_alert& a)
+	{
+		return json_t
+		{
+			{ "login",			a.login },
+			{ "level",			a.level },
+			{ "equity",			a.equity },
+			{ "margin",			a.margin },
+			{ "margin_level",	a.margin_level },
+		};
+	}
+
+	void from_json(const json_t& j, quote_batch& b)
+	{
+		b.source = j.value("source", std::string{});
+		const auto& quotes = j.at("quotes");
+		b.quotes.reserve(quotes.size());
+		for (const auto& q : quotes)
+		{
+			b.quotes.push_back(quote{
+				.symbol = q.at("symbol").get<std::string>(),
+				.bid = q.at("bid").get<double>(),
+				.ask = q.at("ask").get<double>(),
+				.time = q.value("time", int64_t{ 0 }),
+			});
+		}
+	}
+
+	void from_json(const json_t& j, export_request& req)
+	{
+		j.at("export_id").get_to(req.export_id);
+		const auto& kind = j.at("kind");
+		if (kind == "users")
+		{
+			req.kind = export_request::USERS;
+		}
+		else if (kind == "closed_trades")
+		{
+			req.kind = export_request::CLOSED_TRADES;
+		}
+		else
+		{
+			throw std::invalid_argument("invalid kind");
+		}
+		const auto destination = j.value("destination", std::string{ "nats" });
+		if (destination == "nats")
+		{
+			req.destination = export_request::NATS;
+		}
+		else if (destination == "files")
+		{
+			req.destination = export_request::FILES;
+		}
+		else
+		{
+			throw std::invalid_argument("invalid destination");
+		}
+		req.groups = j.value("groups", std::string{ "*" });
+		// Closed orders need an explicit range, a default one would silently export nothing.
+		req.from = req.kind == export_request::CLOSED_TRADES ? j.at("from").get<int64_t>() : j.value("from", int64_t{ 0 });
+		req.to = req.kind == export_request::CLOSED_TRADES ? j.at("to").get<int64_t>() : j.value("to", int64_t{ 0 });
+		req.logins_per_slice = j.value("logins_per_slice", size_t{ 1000 });
+		req.slice_seconds = j.value("slice_seconds", int64_t{ 86400 });
+		req.resume_login = j.value("resume_login", 0);
+	}
+
+	json_t to_json(const export_progress& p)
+	{
+		return json_t
+		{
+			{ "export_id",		p.export_id },
+			{ "finished",		p.finished },
+			{ "reject_code",	p.reject_code },
+			{ "reject_message",	p.reject_message },
+			{ "slices",			p.slices },
+			{ "cursor_login",	p.cursor_login },
+			{ "rows",			p.rows },
+		};
+	}
+
+	json_t to_json(const exposure_update& u)
+	{
+		auto exposures = json_t::array();
+		for (const auto& e : u.exposures)
+		{
+			exposures.push_back(json_t
+			{
+				{ "symbol",			e.symbol },
+				{ "group",			e.group },
+				{ "long_volume",	e.long_volume },
+				{ "short_volume",	e.short_volume },
+				{ "net_volume",		e.long_volume - e.short_volume },
+				{ "long_notional",	e.long_notional },
+				{ "short_notional",	e.short_notional },
+				{ "net_notional",	e.long_notional - e.short_notional },
+				{ "price",			e.price },
+			});
+		}
+		return json_t
+		{
+			{ "sequence",	u.sequence },
+			{ "exposures",	std::move(exposures) },
+		};
+	}
+
+	void from_json(const json_t& j, exposure_request& req)
+	{
+		req.symbol = j.value("symbol", std::string{});
+		req.group = j.value("group", std::string{});
+	}
+
+	json_t to_json(const trade_stats& s)
+	{
+		return json_t
+		{
+			{ "interval_s",			s.interval_s },
+			{ "accepted",			s.accepted },
+			{ "rejected",			s.rejected },
+			{ "duplicates",			s.duplicates },
+			{ "baskets",			s.baskets },
+			{ "timeouts",			s.timeouts },
+			{ "admitted",			s.admitted },
+			{ "shed_in_flight",		s.shed_in_flight },
+			{ "shed_queue_delay",	s.shed_queue_delay },
+			{ "expired",			s.expired },
+			{ "queue_full",			s.queue_full },
+			{ "nats_dropped",		s.nats_dropped },
+			{ "in_flight",			s.in_flight },
+			{ "pending",			s.pending },
+			{ "queue_delay_us",		s.queue_delay_us },
+		};
+	}
+}
\ No newline at end of file
@@ -15,8 +15,59 @@ namespace mt4
 	struct group_symbol;
 	json_t to_json(const group_symbol&);
 
+	struct symbols_ready;
+	json_t to_json(const symbols_ready&);
+
 	struct trade_request;
-	trade_request from_json(const json_t& j);
+	void from_json(const json_t& j, trade_request& request);
+
+	struct trade_response;
+	json_t to_json(const trade_response&);
+
+	struct trade_basket;
+	void from_json(const json_t& j, trade_basket& basket);
+
+	struct trade_basket_response;
+	json_t to_json(const trade_basket_response&);
+
+	struct mass_trade_request;
+	void from_json(const json_t& j, mass_trade_request& request);
+
+	struct mass_trade_progress;
+	json_t to_json(const mass_trade_progress&);
+
+	struct trade_event_batch;
+	json_t to_json(const trade_event_batch&);
+
+	struct positions_request;
+	void from_json(const json_t& j, positions_request& request);
+
+	struct positions_page;
+	json_t to_json(const positions_page&);
+
+	struct position_deltas;
+	json_t to_json(const position_deltas&);
+
+	struct margin_alert;
+	json_t to_json(const margin_alert&);
+
+	struct quote_batch;
+	void from_json(const json_t& j, quote_batch& batch);
+
+	struct export_request;
+	void from_json(const json_t& j, export_request& request);
+
+	struct export_progress;
+	json_t to_json(const export_progress&);
+
+	struct exposure_update;
+	json_t to_json(const exposure_update&);
+
+	struct exposure_request;
+	void from_json(const json_t& j, exposure_request& request);
+
+	struct trade_stats;
+	json_t to_json(const trade_stats&);
 }
 
 json_t to_json(const FeedTick&);
@@ -0,0 +1,48 @@
+#include "mass_operation.h"
+
+namespace mt4
+{
+	mass_operation::mass_operation(int operation_id, std::string_view reply_to, std::vector<trade_request>&& targets,
+		std::chrono::steady_clock::time_point started)
+		: m_id{ operation_id }
+		, m_reply_to{ reply_to }
+		, m_targets{ std::move(targets) }
+		, m_started{ started }
+	{
+	}
+
+	bool mass_operation::next(size_t& index) noexcept
+	{
+		index = m_next.fetch_add(1, std::memory_order_relaxed);
+		return index < m_targets.size();
+	}
+
+	bool mass_operation::complete(size_t index, const trade_response& response)
+	{
+		if (response.reject_code != 0)
+		{
+			m_failed.fetch_add(1, std::memory_order_relaxed);
+			std::lock_guard lock{ m_mutex };
+			if (m_failures.size() < max_reported_failures)
+			{
+				const auto& target = m_targets[index];
+				m_failures.push_back(mass_trade_failure{ .login = target.login, .order = target.order,
+					.reject_code = response.reject_code, .reject_message = response.reject_message });
+			}
+		}
+		return m_done.fetch_add(1, std::memory_order_acq_rel) + 1 == m_targets.size();
+	}
+
+	mass_trade_progress mass_operation::progress() const
+	{
+		mass_trade_progress progress{ .operation_id = m_id, .finished = finished(), .reject_code = 0, .reject_message = {},
+			.targets = m_targets.size(), .done = m_done.load(std::memory_order_acquire), .failed = m_failed.load(std::memory_order_relaxed) };
+		// Failures are only sent once, with the summary.
+		if (progress.finished)
+		{
+			std::lock_guard lock{ m_mutex };
+			progress.failures = m_failures;
+		}
+		return progress;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "models.h"
+#include "timer_wheel.h"
+
+namespace mt4
+{
+	// One mass close, cancel or modify in flight. Its targets are handed to the trade workers a
+	// window at a time: every finished target releases the next one, so a mass operation never
+	// floods the queues and ordinary requests keep their place in front of it.
+	class mass_operation
+	{
+	public:
+		using ptr_t = std::shared_ptr<mass_operation>;
+
+		// The final progress lists at most this many failures, the count covers them all.
+		static constexpr size_t max_reported_failures = 1000;
+
+		mass_operation(int operation_id, std::string_view reply_to, std::vector<trade_request>&& targets,
+			std::chrono::steady_clock::time_point started);
+
+		mass_operation(const mass_operation&) = delete;
+		mass_operation& operator= (const mass_operation&) = delete;
+
+		// False once every target was handed out.
+		bool next(size_t& index) noexcept;
+		const trade_request& target(size_t index) const noexcept { return m_targets[index]; }
+
+		// True for the call that finishes the last target.
+		bool complete(size_t index, const trade_response& response);
+
+		mass_trade_progress progress() const;
+
+		int id() const noexcept { return m_id; }
+		size_t size() const noexcept { return m_targets.size(); }
+		bool finished() const noexcept { return m_done.load(std::memory_order_acquire) == m_targets.size(); }
+		const std::string& reply_to() const noexcept { return m_reply_to; }
+		std::chrono::steady_clock::time_point started() const noexcept { return m_started; }
+
+		// Set once by the plugin right after the operation starts.
+		timer_wheel::handle			progress_timer;
+
+	private:
+		const int					m_id;
+		const std::string			m_reply_to;
+		const std::vector<trade_request> m_targets;
+		const std::chrono::steady_clock::time_point m_started;
+
+		std::atomic<size_t>			m_next{ 0 };
+		std::atomic<size_t>			m_done{ 0 };
+		std::atomic<size_t>			m_failed{ 0 };
+
+		mutable std::mutex			m_mutex;
+		std::vector<mass_trade_failure> m_failures;
+	};
+}
\ No newline at end of file
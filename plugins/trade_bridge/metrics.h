@@ -0,0 +1,98 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+
+namespace mt4
+{
+	// Lock-free latency histogram with power-of-two microsecond buckets. Hot paths only bump
+	// a counter; the reporter drains it periodically, so every summary covers one interval.
+	class latency_histogram
+	{
+	public:
+		static constexpr size_t buckets_total = 32;
+
+		struct summary
+		{
+			uint64_t	count;
+			uint64_t	p50_us;		// bucket upper bounds, so within a factor of two
+			uint64_t	p99_us;
+			uint64_t	max_us;
+		};
+
+		void record(std::chrono::steady_clock::duration elapsed) noexcept
+		{
+			const auto us = static_cast<uint64_t>(std::max<int64_t>(0,
+				std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count()));
+			const auto bucket = std::min<size_t>(std::bit_width(us), buckets_total - 1);
+			m_buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+
+			auto max = m_max_us.load(std::memory_order_relaxed);
+			while (us > max && !m_max_us.compare_exchange_weak(max, us, std::memory_order_relaxed))
+			{
+			}
+		}
+
+		summary drain() noexcept
+		{
+			std::array<uint64_t, buckets_total> counts{};
+			uint64_t total{ 0 };
+			for (size_t i = 0; i < buckets_total; ++i)
+			{
+				counts[i] = m_buckets[i].exchange(0, std::memory_order_relaxed);
+				total += counts[i];
+			}
+			return summary{
+				.count = total,
+				.p50_us = percentile(counts, total, 50),
+				.p99_us = percentile(counts, total, 99),
+				.max_us = m_max_us.exchange(0, std::memory_order_relaxed)
+			};
+		}
+
+	private:
+		static uint64_t percentile(const std::array<uint64_t, buckets_total>& counts, uint64_t total, uint64_t percent) noexcept
+		{
+			const auto rank = (total * percent + 99) / 100;
+			uint64_t seen{ 0 };
+			for (size_t i = 0; i < buckets_total; ++i)
+			{
+				seen += counts[i];
+				if (seen >= rank && seen != 0)
+				{
+					return uint64_t{ 1 } << i;
+				}
+			}
+			return 0;
+		}
+
+		std::array<std::atomic<uint64_t>, buckets_total>	m_buckets{};
+		std::atomic<uint64_t>								m_max_us{ 0 };
+	};
+
+	// Closes, then cancels and modifies, then new positions, then targets of mass operations.
+	static constexpr size_t trade_priority_levels = 4;
+
+	// Latency of each stage of the trade path, plus the end-to-end time.
+	struct trade_metrics
+	{
+		std::array<latency_histogram, trade_priority_levels> dispatch;	// delivery to execution start, per priority
+		latency_histogram		journal;		// accepted record reaching the disk
+		latency_histogram		resolve;		// account and group lookup
+		latency_histogram		validate;		// local pre-trade checks
+		latency_histogram		execute;		// OrdersOpen / OrdersClose
+		latency_histogram		total;			// delivery to the reply being published
+		latency_histogram		basket;			// delivery to the reply of the basket's last leg
+		std::atomic<uint64_t>	accepted{ 0 };
+		std::atomic<uint64_t>	rejected{ 0 };
+		std::atomic<uint64_t>	baskets{ 0 };
+		std::atomic<uint64_t>	duplicates{ 0 };		// retries answered from the idempotency store
+		std::atomic<uint64_t>	timeouts{ 0 };		// deadlines that answered a queued request
+		std::atomic<uint64_t>	parity_checks{ 0 };	// local checks repeated by the server
+		std::atomic<uint64_t>	parity_mismatches{ 0 };
+	};
+}
\ No newline at end of file
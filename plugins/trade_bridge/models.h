@@ -1,12 +1,16 @@
 #pragma once
 
+#include <optional>
 #include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
 
 namespace mt4
 {
 	struct candle
 	{
-		std::string symbol;
+		std::string_view symbol;
 		int32_t ts;
 		double open;
 		double high;
@@ -24,9 +28,10 @@ namespace mt4
 			TRADE_LONG_ONLY
 		};
 
-		std::string		account_group;
-		std::string		symbol;
-		std::string		description;
+		// Views into the configuration view the row was built from.
+		std::string_view	account_group;
+		std::string_view	symbol;
+		std::string_view	description;
 		int				digits;
 		trade_mode		mode;
 		double			contract_size;
@@ -36,10 +41,27 @@ namespace mt4
 		int             lot_min;
 		int				lot_max;
 		int             lot_step;
+		uint64_t		version;
+	};
+
+	struct symbols_ready
+	{
+		uint64_t		version;
+		size_t			groups;
+		size_t			published;
+		int64_t			elapsed_ms;
 	};
 
 	struct trade_request
 	{
+		enum request_type
+		{
+			NEW,			// market position
+			CLOSE,			// open position, fully or partially
+			CANCEL,			// pending order
+			MODIFY			// stop loss and take profit of a position or pending order
+		};
+
 		enum order_side
 		{
 			BUY,
@@ -47,13 +69,15 @@ namespace mt4
 		};
 
 		int				request_id;
+		request_type	type;
 		order_side		side;
 		int				login;
-		double			volume;
+		double			volume;			// lots
 		double			sl;
 		double			tp;
 		std::string		symbol;
 		std::string		comment;
+		int				order;			// ticket the request applies to, 0 for NEW
 	};
 
 	struct trade_response
@@ -63,4 +87,259 @@ namespace mt4
 		int				reject_code;
 		std::string		reject_message;
 	};
+
+	// Legs are ordinary trade requests, each with its own request id.
+	struct trade_basket
+	{
+		int							basket_id;
+		std::vector<trade_request>	legs;
+	};
+
+	// Leg responses in the order of the request's legs. A basket rejected as a whole has a
+	// reject code and no legs.
+	struct trade_basket_response
+	{
+		int							basket_id;
+		int							reject_code;
+		std::string					reject_message;
+		std::vector<trade_response>	legs;
+	};
+
+	// Applies one action to every open order matching the filter. Explicit logins take
+	// precedence over the group mask.
+	struct mass_trade_request
+	{
+		enum action_type
+		{
+			CLOSE,			// open positions
+			CANCEL,			// pending orders
+			MODIFY			// stop loss and take profit of positions and pending orders
+		};
+
+		int						operation_id;
+		action_type				action;
+		std::string				groups;			// mask as for ClientsGroupsUsers, "*" for all groups
+		std::vector<int>		logins;
+		std::string				symbol;			// empty for all symbols
+		std::optional<double>	sl;				// unset keeps the order's own
+		std::optional<double>	tp;
+		std::string				comment;
+	};
+
+	struct mass_trade_failure
+	{
+		int				login;
+		int				order;
+		int				reject_code;
+		std::string		reject_message;
+	};
+
+	// Streamed while the operation runs; the final one lists the failures.
+	struct mass_trade_progress
+	{
+		int								operation_id;
+		bool							finished;
+		int								reject_code;		// the operation as a whole couldn't start
+		std::string						reject_message;
+		size_t							targets;
+		size_t							done;
+		size_t							failed;
+		std::vector<mass_trade_failure>	failures;
+	};
+
+	// Order lifecycle event from the server's trade hooks. Fixed-size, so a hook can queue it
+	// without allocating.
+	struct trade_event
+	{
+		enum event_kind : uint8_t
+		{
+			OPENED,
+			MODIFIED,
+			ACTIVATED,		// pending order turned into a position
+			CLOSED,
+			DELETED,
+			CLOSED_BY		// closed against an opposite position
+		};
+
+		uint64_t		sequence;		// per login, assigned as the server reports the event, 0 when unnumbered
+		event_kind		kind;
+		int				order;
+		int				login;
+		int				cmd;
+		int				volume;			// lots * 100
+		int				state;
+		int32_t			open_time;
+		int32_t			close_time;
+		int32_t			timestamp;
+		double			open_price;
+		double			sl;
+		double			tp;
+		double			close_price;
+		double			profit;
+		double			commission;
+		double			storage;
+		double			conv_rate;		// profit currency to deposit currency, as of the open
+		char			symbol[12];
+		char			comment[32];
+	};
+
+	struct trade_event_batch
+	{
+		int64_t						epoch;		// publisher start, sequences restart with it
+		uint64_t					dropped;	// events lost to a full queue since the previous batch
+		std::vector<trade_event>	events;
+	};
+
+	// Open positions and pending orders are kept as the last event that touched them.
+	struct positions_request
+	{
+		int				login;			// 0 for every login
+		int				after;			// ticket the previous page ended with, 0 for the first page
+		size_t			limit;
+	};
+
+	// Pages are ordered by ticket. The sequence is that of the index when the page was taken,
+	// deltas above the first page's sequence bring a paged snapshot up to date.
+	struct positions_page
+	{
+		int64_t						epoch;
+		uint64_t					sequence;
+		int							next;		// cursor for the next page, 0 after the last one
+		std::vector<trade_event>	positions;
+	};
+
+	struct position_delta
+	{
+		uint64_t		sequence;
+		bool			removed;
+		trade_event		position;
+	};
+
+	// A new epoch means the index was rebuilt and clients must take a new snapshot.
+	struct position_deltas
+	{
+		int64_t						epoch;
+		std::vector<position_delta>	deltas;
+	};
+
+	struct margin_alert
+	{
+		enum alert_level
+		{
+			OK,
+			MARGIN_CALL,
+			STOP_OUT
+		};
+
+		int				login;
+		alert_level		level;
+		double			equity;
+		double			margin;
+		double			margin_level;	// percent, 0 without margin
+	};
+
+	// Net market exposure of every account to a symbol, or of one group's accounts. Volumes are
+	// in lots, notionals in the symbol's quote currency at the last mid price.
+	struct symbol_exposure
+	{
+		std::string		symbol;
+		std::string		group;			// empty for the total over all groups
+		double			long_volume;
+		double			short_volume;
+		double			long_notional;
+		double			short_notional;
+		double			price;			// 0 before the symbol's first tick
+	};
+
+	// The symbols whose positions or prices moved since the previous update, with their groups.
+	struct exposure_update
+	{
+		uint64_t						sequence;
+		std::vector<symbol_exposure>	exposures;
+	};
+
+	struct exposure_request
+	{
+		std::string		symbol;			// empty for every symbol
+		std::string		group;			// empty for the totals and every group
+	};
+
+	// Bulk export of accounts or closed orders. The logins of the groups are cut into slices and,
+	// for closed orders, the time range too; slices are numbered logins-major, so a run is
+	// resumed by sending the same request with resume_login set to the cursor it reached. The
+	// cursor is a login, not a slice number, so it still holds when accounts were added or
+	// deleted since.
+	struct export_request
+	{
+		enum export_kind
+		{
+			USERS,
+			CLOSED_TRADES
+		};
+
+		enum export_destination
+		{
+			NATS,			// chunks on <server>.mt4_export_chunks.<export_id>
+			FILES			// one file per chunk under export_dir/<export_id>
+		};
+
+		std::string			export_id;		// letters, digits, '-' and '_'
+		export_kind			kind;
+		export_destination	destination;
+		std::string			groups;			// mask as for ClientsGroupsUsers, "*" for all groups
+		int64_t				from;			// close time range of closed orders
+		int64_t				to;
+		size_t				logins_per_slice;
+		int64_t				slice_seconds;
+		int					resume_login;	// logins up to this one are skipped, 0 to start from the first
+	};
+
+	// Every window of the logins up to cursor_login is delivered. It only moves over whole login
+	// slices: a resumed run exports a half-done slice again in full, as it may have gained or
+	// lost logins since. Consumers drop the chunks they already hold by first login and window.
+	struct export_progress
+	{
+		std::string		export_id;
+		bool			finished;
+		int				reject_code;
+		std::string		reject_message;
+		uint64_t		slices;
+		int				cursor_login;
+		uint64_t		rows;
+	};
+
+	// Prices from an external aggregator, fed to the server as if from a feeder.
+	struct quote
+	{
+		std::string		symbol;
+		double			bid;
+		double			ask;
+		int64_t			time;			// unix seconds, 0 for the time of arrival
+	};
+
+	struct quote_batch
+	{
+		std::string			source;		// FeedTick::bank, the configured name when empty
+		std::vector<quote>	quotes;
+	};
+
+	// Trade path counters of one metrics interval, gauges are sampled at its end.
+	struct trade_stats
+	{
+		int64_t			interval_s;
+		uint64_t		accepted;
+		uint64_t		rejected;
+		uint64_t		duplicates;
+		uint64_t		baskets;
+		uint64_t		timeouts;
+		uint64_t		admitted;
+		uint64_t		shed_in_flight;
+		uint64_t		shed_queue_delay;
+		uint64_t		expired;
+		uint64_t		queue_full;
+		int64_t			nats_dropped;		// since start
+		size_t			in_flight;
+		size_t			pending;
+		uint64_t		queue_delay_us;
+	};
 }
\ No newline at end of file
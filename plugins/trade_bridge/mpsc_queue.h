@@ -0,0 +1,99 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <memory>
+#include <new>
+
+namespace mt4
+{
+	// Bounded lock-free queue for many producers and one consumer (Vyukov's ring).
+	// Every cell carries a sequence number, so producers only contend on the tail index.
+	template<typename T>
+	class mpsc_queue
+	{
+		struct cell
+		{
+			std::atomic<size_t>	sequence;
+			T					value;
+		};
+
+	public:
+		explicit mpsc_queue(size_t capacity)
+			: m_mask{ std::bit_ceil(std::max<size_t>(capacity, 2)) - 1 }
+			, m_cells{ new cell[m_mask + 1] }
+		{
+			for (size_t i = 0; i <= m_mask; ++i)
+			{
+				m_cells[i].sequence.store(i, std::memory_order_relaxed);
+			}
+		}
+
+		bool try_push(T&& value)
+		{
+			auto position = m_tail.load(std::memory_order_relaxed);
+			for (;;)
+			{
+				auto& slot = m_cells[position & m_mask];
+				const auto sequence = slot.sequence.load(std::memory_order_acquire);
+				const auto difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+				if (difference == 0)
+				{
+					if (m_tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+					{
+						slot.value = std::move(value);
+						slot.sequence.store(position + 1, std::memory_order_release);
+						return true;
+					}
+				}
+				else if (difference < 0)
+				{
+					return false;
+				}
+				else
+				{
+					position = m_tail.load(std::memory_order_relaxed);
+				}
+			}
+		}
+
+		// Consumer thread only.
+		bool try_pop(T& value)
+		{
+			auto& slot = m_cells[m_head & m_mask];
+			if (slot.sequence.load(std::memory_order_acquire) != m_head + 1)
+			{
+				return false;
+			}
+			value = std::move(slot.value);
+			slot.sequence.store(m_head + m_mask + 1, std::memory_order_release);
+			++m_head;
+			return true;
+		}
+
+		// Consumer thread only.
+		bool empty() const noexcept
+		{
+			return m_cells[m_head & m_mask].sequence.load(std::memory_order_acquire) != m_head + 1;
+		}
+
+		size_t size() const noexcept
+		{
+			return m_tail.load(std::memory_order_relaxed) - m_head_published.load(std::memory_order_relaxed);
+		}
+
+		void publish_head() noexcept
+		{
+			m_head_published.store(m_head, std::memory_order_relaxed);
+		}
+
+	private:
+		const size_t					m_mask;
+		std::unique_ptr<cell[]>			m_cells;
+		alignas(std::hardware_destructive_interference_size) std::atomic<size_t>	m_tail{ 0 };
+		alignas(std::hardware_destructive_interference_size) size_t					m_head{ 0 };
+		std::atomic<size_t>				m_head_published{ 0 };
+	};
+}
\ No newline at end of file
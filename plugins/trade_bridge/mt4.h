@@ -2,6 +2,7 @@
 
 #include <windows.h>
 #include <ctime>
+#include <memory>
 
 #pragma warning(push)
 #pragma warning(disable: 4828)
@@ -9,4 +10,20 @@
 #pragma warning(pop)
 
 #define TIME_RATE				((double)1.6777216)
-#define STDTIME(custom_time)	((DWORD)((double)(custom_time)*TIME_RATE))
\ No newline at end of file
+#define STDTIME(custom_time)	((DWORD)((double)(custom_time)*TIME_RATE))
+
+// Arrays returned by the server API live on the process heap and must go back with HEAP_FREE.
+template<typename T>
+struct heap_array_deleter
+{
+	void operator() (T* array) const noexcept
+	{
+		if (array != nullptr)
+		{
+			HEAP_FREE(array);
+		}
+	}
+};
+
+template<typename T>
+using heap_array_t = std::unique_ptr<T[], heap_array_deleter<T>>;
\ No newline at end of file
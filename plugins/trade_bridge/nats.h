@@ -1,7 +1,10 @@
 #pragma once
 
+#include <chrono>
 #include <memory>
 #include <string>
+#include <vector>
+#include <functional>
 
 #include <tl/expected.hpp>
 #include <nats/nats.h>
@@ -41,11 +44,19 @@ namespace nats
 
 		using nats_msg_t = std::unique_ptr<natsMsg, decltype(&natsMsg_Destroy)>;
 
-		using subscription_read_message_error_t = tl::expected<std::string, std::string>;
-		template<typename Message>
-		using subscription_read_message_result_t = tl::expected<Message, subscription_read_message_error_t>;
-		template<typename Message>
-		using subscription_callback_t = std::function<subscription_read_message_result_t<Message>()>;
+		static constexpr int pending_messages_limit = 1024;
+		static constexpr int pending_bytes_limit = 8 * 1024 * 1024;
+
+	public:
+		using request_handler_t = std::function<void(std::string_view reply_to, std::string_view data)>;
+
+	private:
+		struct subscription_context
+		{
+			std::string			topic;
+			request_handler_t	handler;
+			nats_subscr_t		subscription;
+		};
 
 	public:
 		server()
@@ -77,49 +88,82 @@ namespace nats
 			return {};
 		}
 
-		template<typename Message>
-		tl::expected<subscription_callback_t<Message>, std::string> subscribe_sync(const std::string_view topic_name)
+		tl::expected<void, std::string> publish_raw(const std::string_view topic_name, const std::string_view data)
+		{
+			natsStatus stat = natsConnection_Publish(m_connection.get(), topic_name.data(), data.data(), static_cast<int>(data.size()));
+			if (stat != NATS_OK)
+			{
+				return tl::unexpected<std::string>(natsStatus_GetText(stat));
+			}
+			return {};
+		}
+
+		// Blocks until the server has processed everything published so far, which keeps bulk
+		// publishers from outrunning the connection buffers.
+		tl::expected<void, std::string> flush(std::chrono::milliseconds timeout)
+		{
+			if (auto status = natsConnection_FlushTimeout(m_connection.get(), timeout.count()); status != NATS_OK)
+			{
+				return tl::unexpected<std::string>(natsStatus_GetText(status));
+			}
+			return {};
+		}
+
+		// Handler is invoked on the subscription's NATS delivery thread, so it must hand any heavy
+		// work off. Subscriptions don't occupy plugin workers, any number of them can be active.
+		tl::expected<void, std::string> subscribe(const std::string_view topic_name, request_handler_t handler)
 		{
+			auto context = std::make_unique<subscription_context>(subscription_context{ std::string{ topic_name }, std::move(handler), nullptr });
+
 			natsSubscription* raw_sub = nullptr;
-			if (auto status = natsConnection_SubscribeSync(&raw_sub, m_connection.get(), topic_name.data()); status != NATS_OK)
+			if (auto status = natsConnection_Subscribe(&raw_sub, m_connection.get(), topic_name.data(), &server::on_message, context.get()); status != NATS_OK)
 			{
 				return tl::unexpected<std::string>(natsStatus_GetText(status));
 			}
-			nats_subscr_t sub{ raw_sub, nats_subscr_deleter{} };
-			if (auto status = natsSubscription_SetPendingLimits(sub.get(), 1024, 8 * 1024 * 1024); status != NATS_OK)
+			context->subscription = nats_subscr_t{ raw_sub, nats_subscr_deleter{} };
+			if (auto status = natsSubscription_SetPendingLimits(raw_sub, pending_messages_limit, pending_bytes_limit); status != NATS_OK)
 			{
 				return tl::unexpected<std::string>(natsStatus_GetText(status));
 			}
+			m_subscriptions.push_back(std::move(context));
+			return {};
+		}
 
-            return [sub, topic_name = std::string(topic_name)]() mutable -> subscription_read_message_result_t<Message>
-            {
-                natsMsg* raw_msg = nullptr;
-                natsStatus status = natsSubscription_NextMsg(&raw_msg, sub.get(), 2000);
-                nats_msg_t msg{ raw_msg, natsMsg_Destroy };
-                switch (status)
-                {
-                case NATS_TIMEOUT:
-					return tl::unexpected{ "Timeout waiting for message on topic: " + topic_name };
-                case NATS_CONNECTION_CLOSED:
-                    return tl::unexpected{ "Connection subscription closed for topic: " + topic_name };
-
-                case NATS_INVALID_SUBSCRIPTION:
-                    return tl::unexpected{ subscription_read_message_error_t{ tl::unexpected{ "Invalid subscription for topic: " + topic_name } } };
-				case NATS_OK:
-					const auto data = natsMsg_GetData(msg.get());
-					auto result = Marshaler::template unmarshal<Message>(data);
-					if (result)
-					{
-						return *result;
-					}
-
-					return tl::unexpected{ subscription_read_message_error_t{ tl::unexpected{ "Failed to unmarshal message from topic: " + topic_name + ", data: " + data + " error: " + result.error() } } };
-                }
-				return tl::unexpected{ subscription_read_message_error_t{ tl::unexpected{ "Unknown error while reading message from topic: " + topic_name } } };
-            };
+		// Messages the client discarded since subscribing because the handler fell behind the pending limits.
+		int64_t dropped(const std::string_view topic_name) const
+		{
+			int64_t total{ 0 };
+			for (const auto& context : m_subscriptions)
+			{
+				int64_t dropped{ 0 };
+				if (context->topic == topic_name && natsSubscription_GetDropped(context->subscription.get(), &dropped) == NATS_OK)
+				{
+					total += dropped;
+				}
+			}
+			return total;
+		}
+
+		// Drains every subscription, so no handler runs once this returns.
+		void unsubscribe_all()
+		{
+			m_subscriptions.clear();
 		}
 
 	private:
+		static void on_message(natsConnection*, natsSubscription*, natsMsg* raw_msg, void* closure)
+		{
+			nats_msg_t msg{ raw_msg, natsMsg_Destroy };
+			const auto context = static_cast<subscription_context*>(closure);
+			const auto reply_to = natsMsg_GetReply(msg.get());
+			context->handler(
+				reply_to != nullptr ? std::string_view{ reply_to } : std::string_view{},
+				std::string_view{ natsMsg_GetData(msg.get()), static_cast<size_t>(natsMsg_GetDataLength(msg.get())) }
+			);
+		}
+
 		nats_conn_t		m_connection;
+		// Declared after the connection so subscriptions are drained before it goes away.
+		std::vector<std::unique_ptr<subscription_context>>	m_subscriptions;
 	};
 }
\ No newline at end of file
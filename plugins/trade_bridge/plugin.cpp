@@ -1,7 +1,15 @@
 #include "plugin.h"
 
-#include <unordered_set>
+#include <array>
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstring>
+#include <ctime>
+#include <limits>
 #include <thread>
+#include <unordered_map>
+#include <unordered_set>
 #include <fstream>
 #include <filesystem>
 
@@ -15,40 +23,99 @@ namespace
 {
 	const auto ini_file = "./mt4api.ini";
 	
-	const auto chart_periods = { PERIOD_M1, PERIOD_M5, PERIOD_M15, PERIOD_M30, PERIOD_H1, PERIOD_H4, PERIOD_D1, PERIOD_W1, PERIOD_MN1 };
+	constexpr std::array chart_periods = { PERIOD_M1, PERIOD_M5, PERIOD_M15, PERIOD_M30, PERIOD_H1, PERIOD_H4, PERIOD_D1, PERIOD_W1, PERIOD_MN1 };
+	static_assert(chart_periods.size() == mt4::plugin::chart_periods_total);
+
+	constexpr time_t chart_point_not_loaded = -1;
+
+	size_t chart_period_index(int period)
+	{
+		size_t index = 0;
+		for (const auto chart_period : chart_periods)
+		{
+			if (chart_period == period)
+			{
+				break;
+			}
+			++index;
+		}
+		return index;
+	}
 
 	static const int sleep_iteration_count = 64; // Number of iterations before sleep
 
-	tl::expected<mt4::group_symbol, bool> make_group_symbol(const ConGroup& group, const ConSymbol& symbol, const ConGroupMargin* symbol_margin_sec)
+	const ConGroupMargin* find_symbol_margin(const ConGroup& group, const std::string_view symbol)
 	{
-		const auto symbol_sec_group = &group.secgroups[symbol.type];
-		if (symbol_sec_group->show == 0)
+		for (int i = 0; i < group.secmargins_total; ++i)
+		{
+			if (std::string_view{ group.secmargins[i].symbol } == symbol) // strcmp_s ? no way
+			{
+				return &group.secmargins[i];
+			}
+		}
+		return nullptr;
+	}
+
+	template<size_t Size>
+	std::string_view bounded(const char (&name)[Size]) noexcept
+	{
+		return std::string_view{ name, strnlen(name, Size) };
+	}
+
+	constexpr std::array<const char*, mt4::trade_priority_levels> trade_priority_names = { "close", "cancel/modify", "new", "mass cancel/modify" };
+	constexpr size_t mass_trade_priority = 3;
+
+	// How long a mass operation target waits for room in a full queue before the next try.
+	constexpr std::chrono::milliseconds mass_trade_retry{ 10 };
+
+	// Requests that reduce risk go ahead of the ones that add it.
+	size_t trade_priority_of(const mt4::trade_request& request)
+	{
+		switch (request.type)
 		{
-			return tl::unexpected{ false };
+		case mt4::trade_request::CLOSE:
+			return 0;
+		case mt4::trade_request::CANCEL:
+		case mt4::trade_request::MODIFY:
+			return 1;
+		default:
+			return 2;
 		}
+	}
 
-		auto symbol_trade_mode = static_cast<mt4::group_symbol::trade_mode>(symbol.trade);
-		if (symbol.long_only)
+	mt4::group_symbol::trade_mode trade_mode_of(const mt4::group_masks& masks, mt4::symbol_id id)
+	{
+		if (masks.long_only.test(id))
 		{
-			symbol_trade_mode = mt4::group_symbol::TRADE_LONG_ONLY;
+			return mt4::group_symbol::TRADE_LONG_ONLY;
 		}
-		if (symbol_sec_group->trade == 0)
+		if (masks.tradeable.test(id))
 		{
-			symbol_trade_mode = mt4::group_symbol::TRADE_NO;
+			return mt4::group_symbol::TRADE_FULL;
 		}
+		return masks.close_only.test(id) ? mt4::group_symbol::TRADE_CLOSE : mt4::group_symbol::TRADE_NO;
+	}
+
+	// Callers iterate the group's visible set, so visibility is not checked again here.
+	// The row refers to the group and symbol strings, it must not outlive the view they come from.
+	mt4::group_symbol make_group_symbol(const ConGroup& group, const mt4::group_masks& masks, mt4::symbol_id id, const ConSymbol& symbol, uint64_t version)
+	{
+		const auto symbol_sec_group = &group.secgroups[symbol.type];
+		const auto symbol_margin_sec = find_symbol_margin(group, symbol.symbol);
 		return mt4::group_symbol{
-			.account_group = group.group,
-			.symbol = symbol.symbol,
-			.description = symbol.description,
+			.account_group = bounded(group.group),
+			.symbol = bounded(symbol.symbol),
+			.description = bounded(symbol.description),
 			.digits = symbol.digits,
-			.mode = symbol_trade_mode,
+			.mode = trade_mode_of(masks, id),
 			.contract_size = symbol.contract_size,
 			.tick_size = symbol.tick_size,
 			.swap_long = symbol_margin_sec != nullptr ? symbol_margin_sec->swap_long : symbol.swap_long,
 			.swap_short = symbol_margin_sec != nullptr ? symbol_margin_sec->swap_short : symbol.swap_short,
 			.lot_min = symbol_sec_group->lot_min,
 			.lot_max = symbol_sec_group->lot_max,
-			.lot_step = symbol_sec_group->lot_step
+			.lot_step = symbol_sec_group->lot_step,
+			.version = version
 		};
 	}
 
@@ -57,6 +124,8 @@ namespace
 		return path / fmt::format("{}{}.timepoint", symbol, period);
 	}
 
+	// Checkpoints live in the state file. These files stand in for it when it can't be opened,
+	// and are read once after an upgrade.
 	void save_chart_point(const std::filesystem::path& path, const std::string_view symbol, time_t timestamp, int period)
 	{
 		auto file_path = get_file_path(path, symbol, period);
@@ -73,13 +142,113 @@ namespace
 		return value;
 	}
 
-	struct config
+	template<typename T>
+	uint64_t hash_field(const T& value, uint64_t seed)
+	{
+		return tools::hash_bytes(&value, sizeof(value), seed);
+	}
+
+	template<size_t Size>
+	uint64_t hash_name(const char (&name)[Size], uint64_t seed = 14695981039346656037ull)
 	{
-		std::string		server_name;
-		std::string		nats_url;
-		size_t			pool_size;
-		time_t			last_chart_sync_time;
-	};
+		return tools::hash_bytes(name, strnlen(name, Size), seed);
+	}
+
+	// Only the fields that end up in group_symbol, so unrelated edits don't trigger a republish.
+	uint64_t hash_symbol(const ConSymbol& symbol)
+	{
+		auto hash = hash_name(symbol.symbol);
+		hash = hash_name(symbol.description, hash);
+		hash = hash_field(symbol.type, hash);
+		hash = hash_field(symbol.digits, hash);
+		hash = hash_field(symbol.trade, hash);
+		hash = hash_field(symbol.long_only, hash);
+		hash = hash_field(symbol.contract_size, hash);
+		hash = hash_field(symbol.tick_size, hash);
+		hash = hash_field(symbol.swap_long, hash);
+		return hash_field(symbol.swap_short, hash);
+	}
+
+	uint64_t hash_group(const ConGroup& group)
+	{
+		auto hash = hash_name(group.group);
+		for (const auto& sec : group.secgroups)
+		{
+			hash = hash_field(sec.show, hash);
+			hash = hash_field(sec.trade, hash);
+			hash = hash_field(sec.lot_min, hash);
+			hash = hash_field(sec.lot_max, hash);
+			hash = hash_field(sec.lot_step, hash);
+		}
+		for (int i = 0; i < group.secmargins_total; ++i)
+		{
+			hash = hash_name(group.secmargins[i].symbol, hash);
+			hash = hash_field(group.secmargins[i].swap_long, hash);
+			hash = hash_field(group.secmargins[i].swap_short, hash);
+		}
+		return hash;
+	}
+
+	// Saved entries by name: ids are assigned in server order and may differ between runs.
+	template<typename Entry, size_t Size>
+	std::unordered_map<std::string_view, const Entry*> saved_entries(const Entry (&entries)[Size])
+	{
+		std::unordered_map<std::string_view, const Entry*> result{};
+		for (const auto& entry : entries)
+		{
+			if (const auto name = bounded(entry.name); !name.empty())
+			{
+				result.emplace(name, &entry);
+			}
+		}
+		return result;
+	}
+}
+
+template<typename Archive>
+void serialize(Archive& ar, mt4::plugin::config& cfg)
+{
+	ar("mt4api")
+		& Archive::make_item("server_name", cfg.server_name)
+		& Archive::make_item("nats_url", cfg.nats_url)
+		& Archive::make_item("pool_size", cfg.pool_size)[0]
+		& Archive::make_item("last_chart_sync_time", cfg.last_chart_sync_time)[0]
+		& Archive::make_item("catalog_name", cfg.catalog_name)[""]
+		& Archive::make_item("warmup_batch_size", cfg.warmup_batch_size)[256]
+		& Archive::make_item("warmup_flush_timeout_ms", cfg.warmup_flush_timeout_ms)[5000]
+		& Archive::make_item("state_file", cfg.state_file)["./mt4api.state"]
+		& Archive::make_item("state_save_interval_s", cfg.state_save_interval_s)[60]
+		& Archive::make_item("trade_shards", cfg.trade_shards)[2]
+		& Archive::make_item("trade_queue_capacity", cfg.trade_queue_capacity)[4096]
+		& Archive::make_item("trade_first_cpu", cfg.trade_first_cpu)[-1]
+		& Archive::make_item("trade_validation_parity", cfg.trade_validation_parity)[false]
+		& Archive::make_item("idempotency_memory_kb", cfg.idempotency_memory_kb)[4096]
+		& Archive::make_item("idempotency_ttl_s", cfg.idempotency_ttl_s)[300]
+		& Archive::make_item("trade_max_in_flight", cfg.trade_max_in_flight)[4096]
+		& Archive::make_item("trade_max_queue_delay_ms", cfg.trade_max_queue_delay_ms)[500]
+		& Archive::make_item("trade_max_bypass", cfg.trade_max_bypass)[8]
+		& Archive::make_item("trade_request_timeout_ms", cfg.trade_request_timeout_ms)[5000]
+		& Archive::make_item("trade_basket_max_legs", cfg.trade_basket_max_legs)[256]
+		& Archive::make_item("mass_trade_window", cfg.mass_trade_window)[64]
+		& Archive::make_item("mass_trade_progress_ms", cfg.mass_trade_progress_ms)[1000]
+		& Archive::make_item("trade_event_queue", cfg.trade_event_queue)[65536]
+		& Archive::make_item("trade_event_batch", cfg.trade_event_batch)[256]
+		& Archive::make_item("trade_event_flush_ms", cfg.trade_event_flush_ms)[5]
+		& Archive::make_item("positions_max_page", cfg.positions_max_page)[5000]
+		& Archive::make_item("exposure_publish_ms", cfg.exposure_publish_ms)[250]
+		& Archive::make_item("account_cache_capacity", cfg.account_cache_capacity)[262144]
+		& Archive::make_item("export_dir", cfg.export_dir)["./exports"]
+		& Archive::make_item("export_workers", cfg.export_workers)[2]
+		& Archive::make_item("export_backoff_ms", cfg.export_backoff_ms)[20]
+		& Archive::make_item("export_max_slices", cfg.export_max_slices)[1000000]
+		& Archive::make_item("quote_ingest", cfg.quote_ingest)[false]
+		& Archive::make_item("quote_ingest_bank", cfg.quote_ingest_bank)["nats"]
+		& Archive::make_item("journal_file", cfg.journal_file)["./mt4api.journal"]
+		& Archive::make_item("journal_records", cfg.journal_records)[65536]
+		& Archive::make_item("journal_commit_interval_us", cfg.journal_commit_interval_us)[200]
+		& Archive::make_item("journal_commit_records", cfg.journal_commit_records)[64]
+		& Archive::make_item("metrics_interval_s", cfg.metrics_interval_s)[60]
+		& Archive::make_item("timer_resolution_ms", cfg.timer_resolution_ms)[1];
 }
 
 namespace mt4
@@ -103,7 +272,7 @@ namespace mt4
 			return tl::unexpected{ fmt::format("Failed to load configuration from {}: unknown error", ini_file) };
 		}
 
-		if (!cfg.nats_url.empty())
+		if (cfg.nats_url.empty())
 		{
 			return tl::unexpected{ "NATS URL is not configured in the ini file" };
 		}
@@ -115,251 +284,1838 @@ namespace mt4
 		{
 			return tl::unexpected{ "Server name is not configured in the ini file" };
 		}
+		if (cfg.catalog_name.empty())
+		{
+			cfg.catalog_name = fmt::format("Local\\mt4api.{}.catalog", cfg.server_name);
+		}
 
-		return std::make_unique<plugin>(
-			plugin_name,
-			cfg.server_name,
-			cfg.nats_url,
-			mt4server,
-			cfg.pool_size
-		);
+		return plugin::uptr_t{ new plugin(plugin_name, cfg, mt4server) };
     }
 
 	plugin::plugin(
 		const std::string_view plugin_name,
-		const std::string_view server_name,
-		const std::string_view nats_url,
-		CServerInterface* mt4server, 
-		size_t pool_size
+		const config& cfg,
+		CServerInterface* mt4server
 	) noexcept
 		: m_plugin_name{ plugin_name }
 		, m_mt4server{ mt4server }
-		, m_pool{ new pool_t{ pool_size }, thread_pool_deleter{} }
+		, m_pool{ new pool_t{ cfg.pool_size }, thread_pool_deleter{} }
 		, m_logger{ plugin_name, mt4server }
 
-		, m_topic_name_feed_tick{ std::string(server_name) + ".mt4_tick" }
-		, m_topic_name_con_symbol{ std::string(server_name) + ".mt4_symbol" }
-		, m_topic_name_mt4_candle{ std::string(server_name) + ".mt4_candle" }
+		, m_topic_name_feed_tick{ cfg.server_name + ".mt4_tick" }
+		, m_topic_name_con_symbol{ cfg.server_name + ".mt4_symbol" }
+		, m_topic_name_mt4_candle{ cfg.server_name + ".mt4_candle" }
+		, m_topic_name_symbols_snapshot{ cfg.server_name + ".mt4_symbols_snapshot" }
+		, m_topic_name_symbols_ready{ cfg.server_name + ".mt4_symbols_ready" }
+		, m_topic_name_trade_request{ cfg.server_name + ".mt4_trade_request" }
+		, m_topic_name_trade_response{ cfg.server_name + ".mt4_trade_response" }
+		, m_topic_name_trade_stats{ cfg.server_name + ".mt4_trade_stats" }
+		, m_topic_name_trade_basket{ cfg.server_name + ".mt4_trade_basket" }
+		, m_topic_name_trade_basket_response{ cfg.server_name + ".mt4_trade_basket_response" }
+		, m_topic_name_trade_mass{ cfg.server_name + ".mt4_trade_mass" }
+		, m_topic_name_trade_mass_progress{ cfg.server_name + ".mt4_trade_mass_progress" }
+		, m_topic_name_trade_events{ cfg.server_name + ".mt4_trade_events" }
+		, m_topic_name_positions{ cfg.server_name + ".mt4_positions" }
+		, m_topic_name_positions_snapshot{ cfg.server_name + ".mt4_positions_snapshot" }
+		, m_topic_name_margin_alerts{ cfg.server_name + ".mt4_margin_alerts" }
+		, m_topic_name_exposure{ cfg.server_name + ".mt4_exposure" }
+		, m_topic_name_exposure_snapshot{ cfg.server_name + ".mt4_exposure_snapshot" }
+		, m_topic_name_export{ cfg.server_name + ".mt4_export" }
+		, m_topic_name_export_progress{ cfg.server_name + ".mt4_export_progress" }
+		, m_topic_name_export_chunks{ cfg.server_name + ".mt4_export_chunks." }
+		, m_topic_name_quotes{ cfg.server_name + ".mt4_quotes" }
+
+		, m_warmup_batch_size{ std::max<size_t>(cfg.warmup_batch_size, 1) }
+		, m_warmup_flush_timeout{ cfg.warmup_flush_timeout_ms }
 
 		, m_chart_timepoint_dir{ "./charts/" }
+
+		, m_state_save_interval{ std::max<size_t>(cfg.state_save_interval_s, 1) }
+
+		, m_metrics_interval{ std::max<size_t>(cfg.metrics_interval_s, 1) }
+		, m_idempotency{ cfg.idempotency_memory_kb * 1024, std::chrono::seconds{ std::max<size_t>(cfg.idempotency_ttl_s, 1) } }
+		, m_admission{ cfg.trade_max_in_flight, std::chrono::milliseconds{ cfg.trade_max_queue_delay_ms } }
+		, m_pending{ cfg.trade_max_in_flight }
+		, m_trade_request_timeout{ std::max<size_t>(cfg.trade_request_timeout_ms, 1) }
+		, m_trade_basket_max_legs{ std::max<size_t>(cfg.trade_basket_max_legs, 1) }
+		, m_mass_trade_window{ std::max<size_t>(cfg.mass_trade_window, 1) }
+		, m_mass_trade_progress_interval{ std::max<size_t>(cfg.mass_trade_progress_ms, 1) }
+		, m_trade_events{ cfg.trade_event_queue, cfg.trade_event_batch, cfg.account_cache_capacity }
+		, m_positions_max_page{ std::max<size_t>(cfg.positions_max_page, 1) }
+		, m_accounts{ cfg.account_cache_capacity }
+		, m_export_dir{ cfg.export_dir }
+		, m_export_workers{ std::max<size_t>(cfg.export_workers, 1) }
+		, m_export_backoff{ std::max<size_t>(cfg.export_backoff_ms, 1) }
+		, m_export_max_slices{ std::max<size_t>(cfg.export_max_slices, 1) }
+		, m_quotes{ mt4server, m_registry, cfg.quote_ingest_bank }
+		, m_trade_executor{ mt4server, m_config, m_registry, m_accounts, m_logger, m_trade_metrics, cfg.trade_validation_parity }
+		// A deadline per admitted request plus a few periodic duties.
+		, m_timers{ std::chrono::milliseconds{ cfg.timer_resolution_ms }, cfg.trade_max_in_flight + 64 }
+		, m_trade_shards{ cfg.trade_shards, cfg.trade_queue_capacity, cfg.trade_first_cpu, static_cast<uint32_t>(cfg.trade_max_bypass), [this](trade_task& task)
+			{
+				const auto waited = std::chrono::steady_clock::now() - task.received;
+				m_trade_metrics.dispatch[task.priority].record(waited);
+				if (task.mass)
+				{
+					on_mass_result(task.mass, task.leg, execute_journaled(task.request, task.mass->id()));
+					return;
+				}
+				// The deadline answered the request already, it must not execute after the client gave up.
+				if (!m_pending.claim(task.pending))
+				{
+					m_admission.release();
+					return;
+				}
+				m_timers.cancel(task.deadline);
+				auto response = m_admission.on_dispatched(waited)
+					? on_trade_request(task.request, task.received)
+					: reject_busy(task.request.request_id, "Trade request expired in the queue");
+				respond(m_pending.reply_to(task.pending), task.basket, task.leg, std::move(response));
+				m_trade_metrics.total.record(std::chrono::steady_clock::now() - task.received);
+				m_pending.erase(task.pending);
+				m_admission.release();
+			}, [this](trade_task& task)
+			{
+				const auto reason = "Plugin stopped before the request executed";
+				if (task.mass)
+				{
+					on_mass_result(task.mass, task.leg, reject_busy(task.request.request_id, reason));
+					return;
+				}
+				if (!m_pending.claim(task.pending))
+				{
+					m_admission.release();
+					return;
+				}
+				m_timers.cancel(task.deadline);
+				respond(m_pending.reply_to(task.pending), task.basket, task.leg, reject_busy(task.request.request_id, reason));
+				m_pending.erase(task.pending);
+				m_admission.release();
+			} }
 	{
-		if (auto result = connect_to_nats(nats_url); !result)
+		for (auto& checkpoints : m_chart_checkpoints)
+		{
+			for (auto& checkpoint : checkpoints)
+			{
+				checkpoint.store(chart_point_not_loaded, std::memory_order_relaxed);
+			}
+		}
+		load_config();
+
+		m_timers.every(m_state_save_interval, [this]() { m_pool->detach_task([this]() { save_state(); }, BS::pr::low); });
+		m_timers.every(m_metrics_interval, [this]() { m_pool->detach_task([this]() { log_metrics(); }, BS::pr::low); });
+		m_timers.every(std::chrono::milliseconds{ std::max<size_t>(cfg.trade_event_flush_ms, 1) }, [this]()
+		{
+			if (!m_trade_events.idle() && m_trade_events.try_acquire())
+			{
+				m_pool->detach_task([this]() { publish_trade_events(); }, BS::pr::high);
+			}
+		});
+		// However often ticks move a symbol, its exposure goes out at most once per interval.
+		m_timers.every(std::chrono::milliseconds{ std::max<size_t>(cfg.exposure_publish_ms, 1) }, [this]()
+		{
+			if (m_exposure.changed() && !m_exposure_publishing.exchange(true))
+			{
+				m_pool->detach_task([this]() { publish_exposure(); }, BS::pr::normal);
+			}
+		});
+		m_timers.start();
+
+		if (auto result = m_state.open(cfg.state_file); !result)
+		{
+			m_logger.log_error("Failed to open state file '{}': {}", cfg.state_file, result.error());
+		}
+		else
+		{
+			restore_state();
+		}
+
+		if (auto result = m_journal.open(cfg.journal_file, cfg.journal_records,
+			std::chrono::microseconds{ cfg.journal_commit_interval_us }, cfg.journal_commit_records); !result)
+		{
+			m_logger.log_error("Failed to open trade journal '{}', trading without it: {}", cfg.journal_file, result.error());
+		}
+
+		if (auto result = m_catalog.open(cfg.catalog_name); !result)
+		{
+			m_logger.log_error("Failed to open shared catalog '{}': {}", cfg.catalog_name, result.error());
+		}
+		else
+		{
+			m_catalog.publish(*m_config.view(), m_registry);
+		}
+
+		// Trade and user hooks reach the plugin only once it is started, so no change can slip past the sweep.
+		{
+			int users_total{ 0 };
+			const heap_array_t<UserRecord> users{ m_mt4server->ClientsAllUsers(&users_total) };
+			const std::span<const UserRecord> all{ users.get(), users ? static_cast<size_t>(users_total) : size_t{ 0 } };
+			seed_accounts(all);
+			seed_positions(all);
+		}
+
+		if (auto result = connect_to_nats(cfg.nats_url); !result)
 		{
 			m_logger.log_error("Failed to connect to NATS: {}", result.error());
 			return;
 		}
-		if (auto result = nats_subscribe_to_trade_request(server_name); !result)
+		// Before subscribing, so no new request touches an order still being reconciled.
+		recover_trades();
+		if (auto result = nats_subscribe_to_trade_request(); !result)
 		{
 			m_logger.log_error("Failed to subscribe to trade request: {}", result.error());
 			return;
 		}
-
-	}
-
-	tl::expected<void, std::string> plugin::connect_to_nats(const std::string_view url)
-	{
-		return m_nats_conn.connect(url);
-	}
-
-	tl::expected<void, std::string> plugin::nats_subscribe_to_trade_request(const std::string_view server_name)
-	{
-		const auto topic_name = std::string(server_name) + ".trade.request";
-		const auto read_next_message = m_nats_conn.subscribe_sync<trade_request>(topic_name);
-		if (!read_next_message)
+		if (auto result = nats_subscribe_to_trade_basket(); !result)
+		{
+			m_logger.log_error("Failed to subscribe to trade basket: {}", result.error());
+			return;
+		}
+		if (auto result = nats_subscribe_to_mass_trade(); !result)
+		{
+			m_logger.log_error("Failed to subscribe to mass trade: {}", result.error());
+			return;
+		}
+		if (auto result = nats_subscribe_to_snapshot_request(); !result)
+		{
+			m_logger.log_error("Failed to subscribe to symbols snapshot request: {}", result.error());
+			return;
+		}
+		if (auto result = nats_subscribe_to_positions_request(); !result)
+		{
+			m_logger.log_error("Failed to subscribe to positions snapshot request: {}", result.error());
+			return;
+		}
+		if (auto result = nats_subscribe_to_exposure_request(); !result)
+		{
+			m_logger.log_error("Failed to subscribe to exposure request: {}", result.error());
+			return;
+		}
+		if (auto result = nats_subscribe_to_export(); !result)
 		{
-			return tl::unexpected<std::string>(read_next_message.error());
+			m_logger.log_error("Failed to subscribe to export request: {}", result.error());
+			return;
 		}
-		m_pool->detach_task([this, read_next_message = *read_next_message]() mutable {
-			while (true)
+		if (cfg.quote_ingest)
+		{
+			m_quotes.start();
+			if (auto result = nats_subscribe_to_quotes(); !result)
 			{
-				if (auto message = read_next_message(); message)
-				{
-					on_trade_request(*message);
-				}
-				else
-				{
-					auto error_wrapper = message.error();
-					if (!error_wrapper)
-					{
-						m_logger.log_error("Failed to receive trade request: {}", error_wrapper.error());
-					}
-				}
+				m_logger.log_error("Failed to subscribe to quotes: {}", result.error());
+				return;
 			}
-		}, BS::pr::high);
-		return {};
+		}
 	}
 
-	void plugin::on_trade_request(trade_request& request)
+	plugin::~plugin()
 	{
-		m_logger.log_info("Received trade request with ID: {}", request.request_id);
+		// Subscription handlers post into the pools, so stop them before the pools go away.
+		m_nats_conn.unsubscribe_all();
+		// Deadlines reply over NATS and the periodic duties post into the pool.
+		m_timers.stop();
+		// Requests still queued are answered busy, while the connection is still up.
+		m_trade_shards.stop();
 	}
 
-	void plugin::handle(const FeedTick* tick)
+	void plugin::load_config()
 	{
-		if (tick != nullptr)
+		for (const auto& name : m_config.load(m_mt4server, m_registry))
 		{
-			if (auto status = m_nats_conn.publish(m_topic_name_feed_tick, *tick); !status)
-			{
-				m_logger.log_error("Failed to publish feed tick: {}", status.error());
-			}
+			m_logger.log_error("Failed to register '{}': registry is full", name);
 		}
 	}
 
-	void plugin::handle(const ConSymbol* symbol)
+	void plugin::restore_state()
 	{
-		if (symbol != nullptr)
+		if (const auto torn = m_state.torn(); torn != 0)
 		{
-			publish_symbol_for_groups(*symbol);
+			m_logger.log_error("State file: {} records failed their checksum and were ignored", torn);
+		}
+		const auto previous = m_state.previous();
+		if (previous == nullptr)
+		{
+			m_logger.log_info("No saved state, the warm-up publishes everything");
+			return;
 		}
-	}
 
-	void plugin::handle(const ConGroup* group)
-	{
-		if (group != nullptr)
+		// Versions must keep growing even if the wall clock went back since the last run.
+		m_config.advance(previous->config_version);
+
+		for (const auto& entry : previous->symbols)
 		{
-			publish_group_symbols(*group);
+			const auto id = m_registry.symbols.find(bounded(entry.name));
+			if (id == invalid_id)
+			{
+				continue;
+			}
+			for (size_t i = 0; i < chart_periods_total; ++i)
+			{
+				m_chart_checkpoints[id][i].store(static_cast<time_t>(entry.chart_checkpoints[i]), std::memory_order_relaxed);
+			}
 		}
 	}
 
-	void plugin::publish_chart_by_symbol(const ConSymbol& symbol, int period)
+	void plugin::save_state()
 	{
-		m_pool->detach_task([this, symbol_name = std::string{ symbol.symbol }, digits = symbol.digits, period]()
+		const auto view = m_config.view();
+		const auto result = m_state.save([&](state_file::layout& state)
 		{
-			int count{ 0 };
-			RateInfo* rates = m_mt4server->HistoryQuotes(symbol_name.data(), period, &count);
-			if (rates != nullptr && count > 0)
-			{
-				int published_count{ 0 };
-				const auto from_time = load_chart_point(m_chart_timepoint_dir, symbol_name, period);
-
-				//m_logger.log_info("Publishing chart for symbol: {}, period: {}", symbol_name, period);
+			state.config_version = view->version();
+			state.saved_at = static_cast<int64_t>(std::time(nullptr));
+			state.symbols_total = static_cast<uint32_t>(view->symbols().size());
+			state.groups_total = static_cast<uint32_t>(view->groups().size());
 
-				for (int i = count - 1; i >= 0; --i)
+			for (symbol_id id = 0; id < max_symbols; ++id)
+			{
+				auto& entry = state.symbols[id];
+				entry = {};
+				const auto symbol = view->symbol(id);
+				if (symbol == nullptr)
 				{
-					const auto& rate = rates[i];
-					if (rate.ctm < from_time)
-					{
-						return;
-					}
-					if (should_stop_task(i)) return;
-
-					if (auto status = m_nats_conn.publish(m_topic_name_mt4_candle,
-						candle{
-							.symbol = symbol_name,
-							.ts = rate.ctm,
-							.open = tools::int_price_to_double(rate.open, digits),
-							.high = tools::int_price_to_double(rate.high, digits),
-							.low = tools::int_price_to_double(rate.low, digits),
-							.close = tools::int_price_to_double(rate.close, digits)
-						}
-					); !status)
-					{
-						m_logger.log_error("Failed to publish chart candle for symbol: {}, period: {}: {}", symbol_name, period, status.error());
-					}
-					else
-					{
-						++published_count;
-					}
+					continue;
+				}
+				strncpy(entry.name, symbol->symbol, sizeof(entry.name) - 1);
+				entry.hash = m_symbols_publishing[id].load() == 0 ? hash_symbol(*symbol) : 0;
+				for (size_t i = 0; i < chart_periods_total; ++i)
+				{
+					entry.chart_checkpoints[i] = m_chart_checkpoints[id][i].load(std::memory_order_relaxed);
 				}
-
-				save_chart_point(m_chart_timepoint_dir, symbol_name, rates[count-1].ctm, period);
 			}
-
-			//m_logger.log_info("Finished publishing chart for symbol: {} period: {} candles published: {}", symbol_name, period, published_count);
-		}, BS::pr::low);
+			for (group_id id = 0; id < max_groups; ++id)
+			{
+				auto& entry = state.groups[id];
+				entry = {};
+				const auto group = view->group(id);
+				if (group == nullptr)
+				{
+					continue;
+				}
+				strncpy(entry.name, group->group, sizeof(entry.name) - 1);
+				entry.hash = m_groups_publishing[id].load() == 0 ? hash_group(*group) : 0;
+			}
+		});
+		if (!result)
+		{
+			m_logger.log_error("Failed to save state: {}", result.error());
+		}
 	}
 
-	void plugin::publish_chart()
+	void plugin::log_metrics()
 	{
-		ConSymbol symbol{};
-		for (int i = 0; m_mt4server->SymbolsNext(i, &symbol); ++i)
+		const auto accepted = m_trade_metrics.accepted.exchange(0);
+		const auto rejected = m_trade_metrics.rejected.exchange(0);
+		const auto duplicates = m_trade_metrics.duplicates.exchange(0);
+		const auto baskets = m_trade_metrics.baskets.exchange(0);
+		const auto timeouts = m_trade_metrics.timeouts.exchange(0);
+		const auto admission = m_admission.drain();
+		const auto dropped = m_nats_conn.dropped(m_topic_name_trade_request);
+
+		// Published every interval, even an idle one, so monitoring can tell idle from stuck.
+		if (auto status = m_nats_conn.publish(m_topic_name_trade_stats,
+			trade_stats{
+				.interval_s = m_metrics_interval.count(),
+				.accepted = accepted,
+				.rejected = rejected,
+				.duplicates = duplicates,
+				.baskets = baskets,
+				.timeouts = timeouts,
+				.admitted = admission.admitted,
+				.shed_in_flight = admission.shed_in_flight,
+				.shed_queue_delay = admission.shed_queue_delay,
+				.expired = admission.expired,
+				.queue_full = admission.queue_full,
+				.nats_dropped = dropped,
+				.in_flight = admission.in_flight,
+				.pending = m_pending.size(),
+				.queue_delay_us = admission.queue_delay_us
+			}
+		); !status)
 		{
-			publish_chart_by_symbol(symbol, PERIOD_M1);
+			m_logger.log_error("Failed to publish trade stats: {}", status.error());
 		}
-	}
 
-	void plugin::publish_group_symbols(const ConGroup& group)
-	{
-		m_pool->detach_task([this, group]()
+		// Order events come from every terminal and manager, quotes from the aggregator, and mass
+		// operations journal their own entries: none of it waits for a trade request, each report
+		// covers one interval.
+		if (const auto published = m_trade_events.published(), lost = m_trade_events.lost(); published + lost != 0)
+		{
+			m_logger.log_info("Trade events: {} published, {} lost", published, lost);
+		}
+		if (const auto latency = m_equity_latency.drain(); latency.count != 0)
+		{
+			m_logger.log_info("Equity engine: {} positions of {} accounts, tick latency p50 < {} us, p99 < {} us, max {} us over {} ticks",
+				m_equity.positions(), m_equity.accounts(), latency.p50_us, latency.p99_us, latency.max_us, latency.count);
+		}
+		if (const auto failures = m_journal.failures(); failures != 0)
+		{
+			m_logger.log_error("Trade journal: {} group commits failed, those trades are not durable", failures);
+		}
+		if (const auto commits = m_journal.commits(); commits != 0)
+		{
+			m_logger.log_info("Trade journal: {} group commits", commits);
+		}
+		if (const auto late = m_timers.late(); late != 0)
+		{
+			m_logger.log_error("Timer wheel spent {} ticks in callbacks, they are blocking it", late);
+		}
+		if (const auto quotes = m_quotes.drain(); quotes.received != 0)
 		{
-			m_logger.log_info("Publishing symbols for group: {}", group.group);
+			const auto latency = m_quotes.latency();
+			m_logger.log_info("Quote ingest: {} received, {} applied in {} blocks, {} conflated, {} rejected; arrival to server p50 < {} us, p99 < {} us, max {} us",
+				quotes.received, quotes.applied, quotes.blocks, quotes.conflated, quotes.rejected, latency.p50_us, latency.p99_us, latency.max_us);
+		}
 
-			std::unordered_set<std::string> published_symbols{};
-			for (int i = 0; i < group.secmargins_total; ++i)
+		if (accepted + rejected + duplicates == 0)
+		{
+			return;
+		}
+		size_t deepest{ 0 };
+		for (size_t i = 0; i < m_trade_shards.shards(); ++i)
+		{
+			deepest = std::max(deepest, m_trade_shards.queued(i));
+		}
+		m_logger.log_info("Trade requests: {} accepted, {} rejected, deepest of {} queues holds {}",
+			accepted, rejected, m_trade_shards.shards(), deepest);
+		if (const auto shed = admission.shed_in_flight + admission.shed_queue_delay + admission.expired + admission.queue_full; shed != 0)
+		{
+			m_logger.log_info("Trade overload: {} shed over the in-flight budget, {} over the queue delay budget, {} expired queued, {} on full queues; {} dropped by NATS since start",
+				admission.shed_in_flight, admission.shed_queue_delay, admission.expired, admission.queue_full, dropped);
+		}
+		if (const auto evicted = m_idempotency.evicted(); duplicates + evicted != 0)
+		{
+			m_logger.log_info("Trade retries: {} answered from {} remembered responses, {} evicted before expiry",
+				duplicates, m_idempotency.capacity(), evicted);
+		}
+		if (timeouts != 0)
+		{
+			m_logger.log_info("Trade deadlines: {} requests timed out queued, {} pending", timeouts, m_pending.size());
+		}
+		if (const auto checks = m_trade_metrics.parity_checks.exchange(0); checks != 0)
+		{
+			m_logger.log_info("Trade validation parity: {} of {} checks disagreed with the server",
+				m_trade_metrics.parity_mismatches.exchange(0), checks);
+		}
+		for (size_t level = 0; level < trade_priority_levels; ++level)
+		{
+			if (const auto latency = m_trade_metrics.dispatch[level].drain(); latency.count != 0)
+			{
+				m_logger.log_info("Trade queueing delay of {} requests: p50 < {} us, p99 < {} us, max {} us over {} requests",
+					trade_priority_names[level], latency.p50_us, latency.p99_us, latency.max_us, latency.count);
+			}
+		}
+		const std::pair<const char*, latency_histogram*> stages[] = {
+			{ "journal", &m_trade_metrics.journal },
+			{ "resolve", &m_trade_metrics.resolve },
+			{ "validate", &m_trade_metrics.validate },
+			{ "execute", &m_trade_metrics.execute },
+			{ "total", &m_trade_metrics.total },
+			{ "basket", &m_trade_metrics.basket },
+		};
+		for (const auto& [name, histogram] : stages)
+		{
+			if (const auto latency = histogram->drain(); latency.count != 0)
 			{
-				if (should_stop_task(i)) return;
+				m_logger.log_info("Trade {} latency: p50 < {} us, p99 < {} us, max {} us over {} requests",
+					name, latency.p50_us, latency.p99_us, latency.max_us, latency.count);
+			}
+		}
+	}
 
-				const auto symbol_margin_sec = &group.secmargins[i];
-				ConSymbol symbol{};
-				if (m_mt4server->SymbolsGet(symbol_margin_sec->symbol, &symbol))
+	void plugin::publish_trade_events()
+	{
+		for (;;)
+		{
+			const auto& batch = m_trade_events.take();
+			if (batch.events.empty() && batch.dropped == 0)
+			{
+				break;
+			}
+			if (batch.dropped != 0)
+			{
+				// The index missed those events, only a new sweep can tell what they changed. The
+				// events queued before it go out as they are but stay off the index: the sweep
+				// already saw them, and maybe a dropped close that came after them.
+				m_logger.log_error("Trade events: {} dropped on a full queue, rebuilding the positions index", batch.dropped);
+				// Take refills the same batch, only as many events as were queued before the sweep.
+				auto stale = m_trade_events.queued();
+				do
 				{
-					if (auto result = make_group_symbol(group, symbol, symbol_margin_sec); result)
+					if (auto status = m_nats_conn.publish(m_topic_name_trade_events, batch); !status)
 					{
-						if (auto status = m_nats_conn.publish(m_topic_name_con_symbol, *result); !status)
-						{
-							m_logger.log_error("Failed to publish symbol for group '{}': {}", group.group, status.error());
-						}
+						m_logger.log_error("Failed to publish {} trade events: {}", batch.events.size(), status.error());
+					}
+					if (stale == 0)
+					{
+						break;
 					}
-					published_symbols.emplace(symbol.symbol);
+					m_trade_events.take();
+					stale -= std::min(stale, batch.events.size());
+				} while (!batch.events.empty() || batch.dropped != 0);
+				seed_positions();
+				m_position_deltas.epoch = m_positions.epoch();
+				m_position_deltas.deltas.clear();
+				if (auto status = m_nats_conn.publish(m_topic_name_positions, m_position_deltas); !status)
+				{
+					m_logger.log_error("Failed to announce positions epoch {}: {}", m_position_deltas.epoch, status.error());
 				}
+				continue;
 			}
-
-			ConSymbol symbol{};
-			for (int i = 0; m_mt4server->SymbolsNext(i, &symbol); ++i)
+			if (auto status = m_nats_conn.publish(m_topic_name_trade_events, batch); !status)
 			{
-				if (should_stop_task(i)) return;
+				m_logger.log_error("Failed to publish {} trade events: {}", batch.events.size(), status.error());
+			}
 
-				if (auto result = make_group_symbol(group, symbol, nullptr); result)
+			m_position_deltas.epoch = m_positions.epoch();
+			m_position_deltas.deltas.clear();
+			const auto view = m_config.view();
+			std::vector<int> changed{};
+			for (const auto& event : batch.events)
+			{
+				if (auto delta = m_positions.apply(event))
 				{
-					if (auto status = m_nats_conn.publish(m_topic_name_con_symbol, *result); !status)
+					const auto id = m_registry.symbols.find(bounded(event.symbol));
+					if (delta->removed || (event.cmd != OP_BUY && event.cmd != OP_SELL))
+					{
+						m_equity.remove(event.order);
+						m_exposure.remove(event.order);
+					}
+					else if (const auto symbol = view->symbol(id))
 					{
-						m_logger.log_error("Failed to publish symbol for group '{}': {}", group.group, status.error());
+						m_equity.upsert(event, id, *symbol);
+						m_exposure.upsert(event, id, login_group(event.login));
 					}
+					changed.push_back(event.login);
+					m_position_deltas.deltas.push_back(std::move(*delta));
 				}
 			}
-		}, BS::pr::low);
+			// Margin and balance moved with the positions, only the server knows them exactly.
+			std::sort(changed.begin(), changed.end());
+			changed.erase(std::unique(changed.begin(), changed.end()), changed.end());
+			std::vector<margin_alert> alerts{};
+			for (const auto login : changed)
+			{
+				if (UserRecord record{}; m_mt4server->ClientsUserInfo(login, &record) != FALSE)
+				{
+					anchor_equity(record, *view, alerts);
+				}
+			}
+			publish(alerts);
+			if (!m_position_deltas.deltas.empty())
+			{
+				if (auto status = m_nats_conn.publish(m_topic_name_positions, m_position_deltas); !status)
+				{
+					m_logger.log_error("Failed to publish {} position deltas: {}", m_position_deltas.deltas.size(), status.error());
+				}
+			}
+			if (batch.events.size() < m_trade_events.batch_size())
+			{
+				break;
+			}
+		}
+		m_trade_events.release();
 	}
 
-	void plugin::publish_symbol_for_groups(const ConSymbol& symbol)
+	void plugin::seed_positions()
 	{
-		m_pool->detach_task([this, symbol]()
-			{
-				m_logger.log_info("Publishing symbol for groups: {}", symbol.symbol);
+		int users_total{ 0 };
+		const heap_array_t<UserRecord> users{ m_mt4server->ClientsAllUsers(&users_total) };
+		seed_positions({ users.get(), users ? static_cast<size_t>(users_total) : size_t{ 0 } });
+	}
 
-				ConGroup group{};
-				for (int i = 0; m_mt4server->GroupsNext(i, &group); ++i)
-				{
-					if (should_stop_task(i)) return;
+	void plugin::seed_positions(std::span<const UserRecord> users)
+	{
+		const auto started = std::chrono::steady_clock::now();
+		std::vector<trade_event> orders{};
+		std::unordered_set<int> holders{};
+		for (const auto& record : users)
+		{
+			UserInfo user{};
+			user.login = record.login;
+			strncpy(user.group, record.group, sizeof(user.group) - 1);
+			int total{ 0 };
+			const heap_array_t<TradeRecord> trades{ m_mt4server->OrdersGetOpen(&user, &total) };
+			for (int j = 0; trades && j < total; ++j)
+			{
+				orders.push_back(make_trade_event(trades[j], trade_event::OPENED));
+			}
+			if (trades && total > 0)
+			{
+				holders.insert(user.login);
+			}
+		}
+		// The engine takes the same orders, anchored with each owner's margin figures as of the sweep.
+		const auto view = m_config.view();
+		m_equity.clear();
+		m_exposure.clear();
+		for (const auto& order : orders)
+		{
+			if (const auto id = m_registry.symbols.find(bounded(order.symbol)); const auto symbol = view->symbol(id))
+			{
+				m_equity.upsert(order, id, *symbol);
+				m_exposure.upsert(order, id, login_group(order.login));
+			}
+		}
+		std::vector<margin_alert> alerts{};
+		for (const auto& record : users)
+		{
+			if (holders.find(record.login) != holders.end())
+			{
+				anchor_equity(record, *view, alerts);
+			}
+		}
+		publish(alerts);
+
+		const auto orders_total = orders.size();
+		m_positions.reset(std::move(orders));
+		m_logger.log_info("Open positions index: {} orders of {} accounts, epoch {}, built in {} ms", orders_total, users.size(),
+			m_positions.epoch(), std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started).count());
+	}
+
+	void plugin::anchor_equity(const UserRecord& record, const config_view& view, std::vector<margin_alert>& alerts)
+	{
+		UserInfo user{};
+		user.login = record.login;
+		strncpy(user.group, record.group, sizeof(user.group) - 1);
+		user.leverage = record.leverage;
+		user.balance = record.balance;
+		user.credit = record.credit;
+		if (const auto group = view.group(m_registry.groups.find(record.group)); group != nullptr)
+		{
+			user.grp = *group;
+		}
+		else if (m_mt4server->GroupsGet(record.group, &user.grp) == FALSE)
+		{
+			m_logger.log_error("Equity engine: unknown group '{}' of login {}", bounded(record.group), record.login);
+			return;
+		}
+		double margin{ 0.0 }, free_margin{ 0.0 }, equity{ 0.0 };
+		if (m_mt4server->TradesMarginGet(record.login, &user, &margin, &free_margin, &equity) == FALSE)
+		{
+			m_logger.log_error("Equity engine: no margin figures for login {}", record.login);
+			return;
+		}
+		m_equity.anchor(record.login, equity, margin, user.grp, alerts);
+	}
+
+	void plugin::publish(const std::vector<margin_alert>& alerts)
+	{
+		for (const auto& alert : alerts)
+		{
+			if (auto status = m_nats_conn.publish(m_topic_name_margin_alerts, alert); !status)
+			{
+				m_logger.log_error("Failed to publish margin alert of login {}: {}", alert.login, status.error());
+			}
+		}
+	}
+
+	void plugin::publish_exposure()
+	{
+		const auto update = m_exposure.take_changed(*m_config.view(), m_registry);
+		m_exposure_publishing.store(false);
+		if (update.exposures.empty())
+		{
+			return;
+		}
+		if (auto status = m_nats_conn.publish(m_topic_name_exposure, update); !status)
+		{
+			m_logger.log_error("Failed to publish exposure of {} symbols and groups: {}", update.exposures.size(), status.error());
+		}
+	}
+
+	void plugin::seed_accounts(std::span<const UserRecord> users)
+	{
+		// Upserts serialize on the cache's write mutex, so pool chunks would only contend for it.
+		const auto started = std::chrono::steady_clock::now();
+		size_t rejected{ 0 };
+		for (const auto& record : users)
+		{
+			if (!m_accounts.upsert(make_account(record, m_registry)))
+			{
+				++rejected;
+			}
+		}
+		m_accounts.set_ready();
+
+		if (rejected != 0)
+		{
+			m_logger.log_error("Account cache: {} of {} accounts don't fit in {} slots, raise account_cache_capacity", rejected, users.size(), m_accounts.capacity());
+		}
+		m_logger.log_info("Account cache: {} accounts, built in {} ms", m_accounts.size(),
+			std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started).count());
+	}
+
+	group_id plugin::login_group(int login) const
+	{
+		const auto cached = m_accounts.find(login);
+		return cached ? cached->group : invalid_id;
+	}
+
+	tl::expected<void, std::string> plugin::connect_to_nats(const std::string_view url)
+	{
+		return m_nats_conn.connect(url);
+	}
+
+	tl::expected<void, std::string> plugin::nats_subscribe_to_trade_request()
+	{
+		return m_nats_conn.subscribe(m_topic_name_trade_request, [this](std::string_view reply_to, std::string_view data)
+		{
+			const auto received = std::chrono::steady_clock::now();
+			auto request = json::marshaler::unmarshal<trade_request>(data);
+			if (!request)
+			{
+				m_logger.log_error("Failed to decode trade request: {}, data: {}", request.error(), data);
+				++m_trade_metrics.rejected;
+				// Without a request id only the sender's own inbox can make sense of the reject.
+				if (!reply_to.empty())
+				{
+					reply(reply_to, trade_response{ .request_id = 0, .order_id = 0, .reject_code = RET_INVALID_DATA, .reject_message = request.error() });
+				}
+				return;
+			}
+			submit_trade(std::move(*request), reply_to, nullptr, 0, received);
+		});
+	}
+
+	tl::expected<void, std::string> plugin::nats_subscribe_to_trade_basket()
+	{
+		return m_nats_conn.subscribe(m_topic_name_trade_basket, [this](std::string_view reply_to, std::string_view data)
+		{
+			const auto received = std::chrono::steady_clock::now();
+			auto basket = json::marshaler::unmarshal<trade_basket>(data);
+			if (!basket)
+			{
+				m_logger.log_error("Failed to decode trade basket: {}, data: {}", basket.error(), data);
+				++m_trade_metrics.rejected;
+				if (!reply_to.empty())
+				{
+					reply(reply_to, trade_basket_response{ .basket_id = 0, .reject_code = RET_INVALID_DATA, .reject_message = basket.error() });
+				}
+				return;
+			}
+			if (basket->legs.size() > m_trade_basket_max_legs)
+			{
+				++m_trade_metrics.rejected;
+				reply(reply_to, trade_basket_response{ .basket_id = basket->basket_id, .reject_code = RET_INVALID_DATA,
+					.reject_message = fmt::format("Basket has {} legs, at most {} are allowed", basket->legs.size(), m_trade_basket_max_legs) });
+				return;
+			}
+			++m_trade_metrics.baskets;
+			// Legs fan out over the workers of their logins and run in parallel, the last one to finish replies.
+			const auto pending = std::make_shared<pending_basket>(basket->basket_id, reply_to, basket->legs.size(), received);
+			for (uint32_t leg = 0; leg < basket->legs.size(); ++leg)
+			{
+				submit_trade(std::move(basket->legs[leg]), {}, pending, leg, received);
+			}
+		});
+	}
+
+	tl::expected<void, std::string> plugin::nats_subscribe_to_mass_trade()
+	{
+		return m_nats_conn.subscribe(m_topic_name_trade_mass, [this](std::string_view reply_to, std::string_view data)
+		{
+			const auto received = std::chrono::steady_clock::now();
+			auto request = json::marshaler::unmarshal<mass_trade_request>(data);
+			if (!request)
+			{
+				m_logger.log_error("Failed to decode mass trade request: {}, data: {}", request.error(), data);
+				reply(reply_to, mass_trade_progress{ .operation_id = 0, .finished = true, .reject_code = RET_INVALID_DATA, .reject_message = request.error() });
+				return;
+			}
+			// Resolving the targets walks the open orders of every matching account, too slow for the NATS thread.
+			m_pool->detach_task([this, request = std::move(*request), reply_to = std::string{ reply_to }, received]()
+			{
+				start_mass_trade(request, reply_to, received);
+			}, BS::pr::high);
+		});
+	}
+
+	void plugin::submit_trade(trade_request&& request, const std::string_view reply_to, const pending_basket::ptr_t& basket, uint32_t leg,
+		std::chrono::steady_clock::time_point received)
+	{
+		const auto login = request.login;
+		const auto request_id = request.request_id;
+		if (auto admitted = m_admission.try_admit(); !admitted)
+		{
+			respond(reply_to, basket, leg, reject_busy(request_id, std::move(admitted.error())));
+			return;
+		}
+		const auto pending = m_pending.insert(login, request_id, reply_to);
+		if (!pending)
+		{
+			m_admission.release();
+			if (pending.error() == correlation_store::ALREADY_PENDING)
+			{
+				++m_trade_metrics.rejected;
+				respond(reply_to, basket, leg, trade_response{ .request_id = request_id, .order_id = 0, .reject_code = RET_TRADE_CONTEXT_BUSY,
+					.reject_message = "Trade request with this id is already in progress" });
+			}
+			else
+			{
+				respond(reply_to, basket, leg, reject_busy(request_id, "Too many pending trade requests"));
+			}
+			return;
+		}
+		const auto deadline = m_timers.arm(m_trade_request_timeout, [this, entry = *pending, request_id, basket, leg]()
+		{
+			on_trade_deadline(entry, request_id, basket, leg);
+		});
+		// Requests of one login stay on one worker, so requests of one priority execute in the order they arrived.
+		const auto priority = trade_priority_of(request);
+		if (!m_trade_shards.submit(static_cast<uint32_t>(login), priority, trade_task{ priority, std::move(request), *pending, deadline, basket, nullptr, leg, received }))
+		{
+			m_timers.cancel(deadline);
+			m_pending.erase(*pending);
+			m_admission.on_queue_full();
+			m_admission.release();
+			respond(reply_to, basket, leg, reject_busy(request_id, "Trade queue is full"));
+		}
+	}
+
+	tl::expected<void, std::string> plugin::nats_subscribe_to_snapshot_request()
+	{
+		return m_nats_conn.subscribe(m_topic_name_symbols_snapshot, [this](std::string_view reply_to, std::string_view)
+		{
+			if (reply_to.empty())
+			{
+				return;
+			}
+			m_pool->detach_task([this, reply_to = std::string{ reply_to }]()
+			{
+				const auto view = m_config.view();
+				const auto blob = m_symbols_snapshot.get(view->version(), [&view]() { return collect_group_symbols(*view); });
+				if (!blob)
+				{
+					m_logger.log_error("Failed to build symbols snapshot: {}", blob.error());
+					return;
+				}
+				if (auto status = m_nats_conn.publish_raw(reply_to, **blob); !status)
+				{
+					m_logger.log_error("Failed to reply with symbols snapshot: {}", status.error());
+				}
+			}, BS::pr::normal);
+		});
+	}
+
+	trade_response plugin::on_trade_request(const trade_request& request, std::chrono::steady_clock::time_point received)
+	{
+		// A login's requests run on one worker, so a retry can't race its original here.
+		if (auto cached = m_idempotency.find(request.login, request.request_id, received))
+		{
+			++m_trade_metrics.duplicates;
+			return std::move(*cached);
+		}
+		auto response = execute_journaled(request);
+		m_idempotency.store(request.login, response, std::chrono::steady_clock::now());
+		return response;
+	}
+
+	trade_response plugin::execute_journaled(const trade_request& request, int operation_id)
+	{
+		// The request must be on disk before the server sees it, otherwise a crash could hide an executed order.
+		auto accepted = trade_journal::accepted(request, m_mt4server->TradeTime(), operation_id);
+		accepted.lsn = m_journal.append(accepted);
+		const auto journaling = std::chrono::steady_clock::now();
+		m_journal.wait_durable(accepted.lsn);
+		m_trade_metrics.journal.record(std::chrono::steady_clock::now() - journaling);
+
+		auto response = m_trade_executor.execute(request);
+		m_journal.append(trade_journal::completed(accepted, response));
+		if (response.reject_code != RET_OK)
+		{
+			m_logger.log_error("Trade request {} rejected with code {}: {}", request.request_id, response.reject_code, response.reject_message);
+		}
+		return response;
+	}
+
+	void plugin::respond(const std::string_view reply_to, const pending_basket::ptr_t& basket, uint32_t leg, trade_response&& response)
+	{
+		if (!basket)
+		{
+			reply(reply_to, response);
+			return;
+		}
+		if (basket->complete(leg, std::move(response)))
+		{
+			reply(basket->reply_to(), basket->response());
+			m_trade_metrics.basket.record(std::chrono::steady_clock::now() - basket->received());
+		}
+	}
+
+	// Requests sent with a reply inbox get the answer there, fire-and-forget ones on the shared response topic.
+	void plugin::reply(const std::string_view reply_to, const trade_response& response)
+	{
+		const auto topic = reply_to.empty() ? std::string_view{ m_topic_name_trade_response } : reply_to;
+		if (auto status = m_nats_conn.publish(topic, response); !status)
+		{
+			m_logger.log_error("Failed to publish trade response for request {}: {}", response.request_id, status.error());
+		}
+	}
+
+	void plugin::reply(const std::string_view reply_to, const trade_basket_response& response)
+	{
+		const auto topic = reply_to.empty() ? std::string_view{ m_topic_name_trade_basket_response } : reply_to;
+		if (auto status = m_nats_conn.publish(topic, response); !status)
+		{
+			m_logger.log_error("Failed to publish trade basket response for basket {}: {}", response.basket_id, status.error());
+		}
+	}
+
+	void plugin::reply(const std::string_view reply_to, const mass_trade_progress& progress)
+	{
+		const auto topic = reply_to.empty() ? std::string_view{ m_topic_name_trade_mass_progress } : reply_to;
+		if (auto status = m_nats_conn.publish(topic, progress); !status)
+		{
+			m_logger.log_error("Failed to publish progress of mass operation {}: {}", progress.operation_id, status.error());
+		}
+	}
+
+	void plugin::reply(const std::string_view reply_to, const export_progress& progress)
+	{
+		const auto topic = reply_to.empty() ? std::string_view{ m_topic_name_export_progress } : reply_to;
+		if (auto status = m_nats_conn.publish(topic, progress); !status)
+		{
+			m_logger.log_error("Failed to publish progress of export '{}': {}", progress.export_id, status.error());
+		}
+	}
+
+	// Overload rejects share one code, so clients can back off instead of treating them as trade errors.
+	trade_response plugin::reject_busy(int request_id, std::string&& reason)
+	{
+		++m_trade_metrics.rejected;
+		return trade_response{ .request_id = request_id, .order_id = 0, .reject_code = RET_TRADE_BROKER_BUSY, .reject_message = std::move(reason) };
+	}
+
+	// Decoded on the delivery thread, which only hands the quotes over; the ingest thread feeds the server.
+	tl::expected<void, std::string> plugin::nats_subscribe_to_quotes()
+	{
+		return m_nats_conn.subscribe(m_topic_name_quotes, [this](std::string_view, std::string_view data)
+		{
+			const auto received = std::chrono::steady_clock::now();
+			auto batch = json::marshaler::unmarshal<quote_batch>(data);
+			if (!batch)
+			{
+				m_logger.log_error("Failed to decode quotes: {}, data: {}", batch.error(), data);
+				return;
+			}
+			m_quotes.push(*batch, received);
+		});
+	}
+
+	tl::expected<void, std::string> plugin::nats_subscribe_to_export()
+	{
+		return m_nats_conn.subscribe(m_topic_name_export, [this](std::string_view reply_to, std::string_view data)
+		{
+			auto request = json::marshaler::unmarshal<export_request>(data);
+			if (!request)
+			{
+				m_logger.log_error("Failed to decode export request: {}, data: {}", request.error(), data);
+				return;
+			}
+			m_pool->detach_task([this, request = std::move(*request), reply_to = std::string{ reply_to }]() mutable
+			{
+				start_export(std::move(request), reply_to);
+			}, BS::pr::low);
+		});
+	}
+
+	tl::expected<void, std::string> plugin::nats_subscribe_to_exposure_request()
+	{
+		return m_nats_conn.subscribe(m_topic_name_exposure_snapshot, [this](std::string_view reply_to, std::string_view data)
+		{
+			if (reply_to.empty())
+			{
+				return;
+			}
+			auto request = json::marshaler::unmarshal<exposure_request>(data.empty() ? std::string_view{ "{}" } : data);
+			if (!request)
+			{
+				m_logger.log_error("Failed to decode exposure request: {}, data: {}", request.error(), data);
+				return;
+			}
+			m_pool->detach_task([this, request = std::move(*request), reply_to = std::string{ reply_to }]()
+			{
+				if (auto status = m_nats_conn.publish(reply_to, m_exposure.snapshot(*m_config.view(), m_registry, request)); !status)
+				{
+					m_logger.log_error("Failed to reply to exposure request: {}", status.error());
+				}
+			}, BS::pr::normal);
+		});
+	}
+
+	tl::expected<void, std::string> plugin::nats_subscribe_to_positions_request()
+	{
+		return m_nats_conn.subscribe(m_topic_name_positions_snapshot, [this](std::string_view reply_to, std::string_view data)
+		{
+			if (reply_to.empty())
+			{
+				return;
+			}
+			auto request = json::marshaler::unmarshal<positions_request>(data.empty() ? std::string_view{ "{}" } : data);
+			if (!request)
+			{
+				m_logger.log_error("Failed to decode positions request: {}, data: {}", request.error(), data);
+				return;
+			}
+			request->limit = std::clamp<size_t>(request->limit, 1, m_positions_max_page);
+			m_pool->detach_task([this, request = *request, reply_to = std::string{ reply_to }]()
+			{
+				if (auto status = m_nats_conn.publish(reply_to, m_positions.page(request)); !status)
+				{
+					m_logger.log_error("Failed to reply with positions page: {}", status.error());
+				}
+			}, BS::pr::normal);
+		});
+	}
+
+	void plugin::on_trade_deadline(correlation_store::handle pending, int request_id, const pending_basket::ptr_t& basket, uint32_t leg)
+	{
+		if (!m_pending.expire(pending))
+		{
+			return;
+		}
+		++m_trade_metrics.timeouts;
+		++m_trade_metrics.rejected;
+		respond(m_pending.reply_to(pending), basket, leg, trade_response{ .request_id = request_id, .order_id = 0, .reject_code = RET_TRADE_TIMEOUT,
+			.reject_message = "Trade request timed out before execution" });
+		m_pending.erase(pending);
+	}
+
+	void plugin::start_mass_trade(const mass_trade_request& request, const std::string& reply_to, std::chrono::steady_clock::time_point received)
+	{
+		auto targets = m_trade_executor.collect_targets(request);
+		const auto operation = std::make_shared<mass_operation>(request.operation_id, reply_to, std::move(targets), received);
+		m_logger.log_info("Mass operation {}: {} orders of {} to act on", request.operation_id, operation->size(),
+			request.logins.empty() ? fmt::format("groups '{}'", request.groups) : fmt::format("{} logins", request.logins.size()));
+		if (operation->size() == 0)
+		{
+			reply(reply_to, operation->progress());
+			return;
+		}
+		operation->progress_timer = m_timers.every(m_mass_trade_progress_interval, [this, operation]()
+		{
+			if (!operation->finished())
+			{
+				reply(operation->reply_to(), operation->progress());
+			}
+		});
+		for (size_t i = 0; i < m_mass_trade_window; ++i)
+		{
+			submit_mass_next(operation);
+		}
+	}
+
+	void plugin::submit_mass_next(const mass_operation::ptr_t& operation)
+	{
+		if (size_t index{ 0 }; operation->next(index))
+		{
+			submit_mass(operation, index);
+		}
+	}
+
+	// Closes reduce risk and share the protective level with ordinary closes. Cancel and modify targets
+	// queue below every ordinary request, the starvation guard still gives them a turn under load.
+	void plugin::submit_mass(const mass_operation::ptr_t& operation, size_t index)
+	{
+		const auto& target = operation->target(index);
+		const auto priority = target.type == trade_request::CLOSE ? trade_priority_of(target) : mass_trade_priority;
+		if (m_trade_shards.submit(static_cast<uint32_t>(target.login), priority,
+			trade_task{ priority, target, {}, {}, nullptr, operation, static_cast<uint32_t>(index), std::chrono::steady_clock::now() }))
+		{
+			return;
+		}
+		// A full queue delays the target rather than failing it, risk operations have to go through.
+		if (!m_timers.arm(mass_trade_retry, [this, operation, index]() { submit_mass(operation, index); }).valid())
+		{
+			on_mass_result(operation, index, reject_busy(target.request_id, "Trade queue is full"));
+		}
+	}
+
+	void plugin::on_mass_result(const mass_operation::ptr_t& operation, size_t index, const trade_response& response)
+	{
+		if (!operation->complete(index, response))
+		{
+			submit_mass_next(operation);
+			return;
+		}
+		m_timers.cancel(operation->progress_timer);
+		const auto progress = operation->progress();
+		reply(operation->reply_to(), progress);
+		m_logger.log_info("Mass operation {} finished in {} ms: {} of {} orders failed", operation->id(),
+			std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - operation->started()).count(),
+			progress.failed, progress.targets);
+	}
+
+	void plugin::start_export(export_request&& request, const std::string& reply_to)
+	{
+		const auto reject = [&](std::string&& reason)
+		{
+			reply(reply_to, export_progress{ .export_id = request.export_id, .finished = true, .reject_code = RET_INVALID_DATA,
+				.reject_message = std::move(reason), .slices = 0, .cursor_login = request.resume_login, .rows = 0 });
+		};
+		// The id names the chunk topic and the chunk directory.
+		if (request.export_id.empty() || !std::all_of(request.export_id.begin(), request.export_id.end(),
+			[](unsigned char c) { return std::isalnum(c) != 0 || c == '-' || c == '_'; }))
+		{
+			reject("Export id must be letters, digits, '-' and '_'");
+			return;
+		}
+		if (request.kind == export_request::CLOSED_TRADES && request.to < request.from)
+		{
+			reject("Export time range is empty");
+			return;
+		}
+		// The server takes 32-bit times, wider ones would also overflow the window count.
+		if (request.kind == export_request::CLOSED_TRADES && (request.from < 0 || request.to > std::numeric_limits<int32_t>::max()))
+		{
+			reject("Export time range must be 32-bit unix seconds");
+			return;
+		}
+		request.logins_per_slice = std::clamp<size_t>(request.logins_per_slice, 1, 100000);
+		request.slice_seconds = std::max<int64_t>(request.slice_seconds, 1);
+		const auto windows = export_job::windows(request);
+
+		if (request.destination == export_request::FILES)
+		{
+			std::error_code error{};
+			std::filesystem::create_directories(m_export_dir / request.export_id, error);
+			if (error)
+			{
+				reject(fmt::format("Failed to create export directory: {}", error.message()));
+				return;
+			}
+		}
+		{
+			std::lock_guard lock{ m_exports_mutex };
+			if (!m_exports.insert(request.export_id).second)
+			{
+				reject("An export with this id is running");
+				return;
+			}
+		}
+
+		int total{ 0 };
+		const heap_array_t<UserRecord> users{ m_mt4server->ClientsGroupsUsers(&total, request.groups.c_str()) };
+		std::vector<int> logins{};
+		logins.reserve(users ? total : 0);
+		for (int i = 0; users && i < total; ++i)
+		{
+			if (users[i].login > request.resume_login)
+			{
+				logins.push_back(users[i].login);
+			}
+		}
+		std::sort(logins.begin(), logins.end());
+
+		// The job keeps a flag per slice, so the count is checked before it's built.
+		const auto login_slices = (logins.size() + request.logins_per_slice - 1) / request.logins_per_slice;
+		if (windows > m_export_max_slices || login_slices > m_export_max_slices / windows)
+		{
+			{
+				std::lock_guard lock{ m_exports_mutex };
+				m_exports.erase(request.export_id);
+			}
+			reject(fmt::format("Export needs {} login slices of {} windows, over export_max_slices {}", login_slices, windows, m_export_max_slices));
+			return;
+		}
+
+		const auto job = std::make_shared<export_job>(std::move(request), reply_to, std::move(logins), std::chrono::steady_clock::now());
+		m_logger.log_info("Export '{}': {} slices over {} accounts of groups '{}', after login {}", job->request().export_id,
+			job->slices(), total, job->request().groups, job->request().resume_login);
+		if (job->progress().finished)
+		{
+			finish_export(job);
+			return;
+		}
+		for (size_t i = 0; i < m_export_workers; ++i)
+		{
+			submit_export_next(job);
+		}
+	}
+
+	void plugin::submit_export_next(const export_job::ptr_t& job)
+	{
+		if (uint64_t slice{ 0 }; job->next(slice))
+		{
+			m_pool->detach_task([this, job, slice]() { run_export_slice(job, slice, false); }, BS::pr::lowest);
+		}
+	}
+
+	void plugin::run_export_slice(const export_job::ptr_t& job, uint64_t slice, bool deferred)
+	{
+		if (!deferred && m_admission.in_flight() != 0 && m_timers.arm(m_export_backoff, [this, job, slice]()
+			{
+				m_pool->detach_task([this, job, slice]() { run_export_slice(job, slice, true); }, BS::pr::lowest);
+			}).valid())
+		{
+			return;
+		}
+
+		auto rows = export_slice(*job, slice);
+		const auto last = rows ? job->complete(slice, *rows) : job->fail(slice, std::move(rows.error()));
+		if (last)
+		{
+			finish_export(job);
+			return;
+		}
+		reply(job->reply_to(), job->progress());
+		submit_export_next(job);
+	}
+
+	tl::expected<size_t, std::string> plugin::export_slice(const export_job& job, uint64_t slice)
+	{
+		const auto logins = job.logins(slice);
+		size_t rows{ 0 };
+		tl::expected<std::string, std::string> chunk{};
+		if (job.request().kind == export_request::USERS)
+		{
+			std::vector<UserRecord> users{};
+			users.reserve(logins.size());
+			for (const auto login : logins)
+			{
+				if (UserRecord record{}; m_mt4server->ClientsUserInfo(login, &record) != FALSE)
+				{
+					users.push_back(record);
+				}
+			}
+			rows = users.size();
+			chunk = encode_users(job, slice, users);
+		}
+		else
+		{
+			const auto [from, to] = job.window(slice);
+			int total{ 0 };
+			const heap_array_t<TradeRecord> trades{ m_mt4server->OrdersGetClosed(static_cast<__time32_t>(from), static_cast<__time32_t>(to),
+				logins.data(), static_cast<int>(logins.size()), &total) };
+			rows = trades ? static_cast<size_t>(total) : 0;
+			chunk = encode_closed_trades(job, slice, std::span<const TradeRecord>{ trades.get(), rows });
+		}
+		if (!chunk)
+		{
+			return tl::unexpected{ std::move(chunk.error()) };
+		}
+
+		const auto& id = job.request().export_id;
+		if (job.request().destination == export_request::FILES)
+		{
+			// Named by position, so the chunks of a resumed run don't overwrite those of the first one.
+			const auto path = m_export_dir / id / fmt::format("{:010}_{:06}.msgpack.z", logins.front(), job.window_index(slice));
+			std::ofstream out(path, std::ios::binary | std::ios::trunc);
+			if (!out.write(chunk->data(), static_cast<std::streamsize>(chunk->size())))
+			{
+				return tl::unexpected{ fmt::format("Failed to write '{}'", path.string()) };
+			}
+			return rows;
+		}
+		if (auto status = m_nats_conn.publish_raw(m_topic_name_export_chunks + id, *chunk); !status)
+		{
+			return tl::unexpected{ fmt::format("Failed to publish chunk: {}", status.error()) };
+		}
+		// Keeps the export from filling the connection buffers live messages go through.
+		if (auto status = m_nats_conn.flush(std::chrono::seconds{ 5 }); !status)
+		{
+			return tl::unexpected{ fmt::format("Failed to flush chunk: {}", status.error()) };
+		}
+		return rows;
+	}
+
+	void plugin::finish_export(const export_job::ptr_t& job)
+	{
+		const auto progress = job->progress();
+		reply(job->reply_to(), progress);
+		{
+			std::lock_guard lock{ m_exports_mutex };
+			m_exports.erase(job->request().export_id);
+		}
+		const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - job->started()).count();
+		if (progress.reject_code != 0)
+		{
+			m_logger.log_error("Export '{}' stopped after {} ms at login {}, {} slices: {}", progress.export_id, elapsed,
+				progress.cursor_login, progress.slices, progress.reject_message);
+			return;
+		}
+		m_logger.log_info("Export '{}' finished in {} ms: {} rows in {} slices", progress.export_id, elapsed, progress.rows, progress.slices);
+	}
+
+	void plugin::recover_trades()
+	{
+		const auto& unfinished = m_journal.unfinished();
+		if (unfinished.empty())
+		{
+			return;
+		}
+		m_logger.log_info("Trade journal: reconciling {} requests left unanswered by the previous run", unfinished.size());
+		std::unordered_set<int> claimed{};
+		std::unordered_map<int, mass_trade_progress> operations{};
+		for (const auto& entry : unfinished)
+		{
+			const auto response = reconcile(entry, claimed);
+			m_journal.append(trade_journal::completed(entry, response));
+			if (entry.operation_id != 0)
+			{
+				// Target numbers are no client request ids, the outcome is reported with its operation.
+				auto& progress = operations.try_emplace(entry.operation_id, mass_trade_progress{ .operation_id = entry.operation_id,
+					.finished = true, .reject_code = 0, .reject_message = {}, .targets = 0, .done = 0, .failed = 0 }).first->second;
+				++progress.targets;
+				++progress.done;
+				if (response.reject_code != RET_OK)
+				{
+					++progress.failed;
+					progress.failures.push_back(mass_trade_failure{ .login = entry.login, .order = entry.order,
+						.reject_code = response.reject_code, .reject_message = response.reject_message });
+				}
+				m_logger.log_info("Target {} of mass operation {} reconciled: order {}, code {}, {}",
+					entry.request_id, entry.operation_id, response.order_id, response.reject_code, response.reject_message);
+				continue;
+			}
+			// The original reply inbox is gone, the outcome goes to the response topic and to retries.
+			m_idempotency.store(entry.login, response, std::chrono::steady_clock::now());
+			reply({}, response);
+			m_logger.log_info("Trade request {} of login {} reconciled: order {}, code {}, {}",
+				entry.request_id, entry.login, response.order_id, response.reject_code, response.reject_message);
+		}
+		// Only the targets that were in flight, the rest of each operation was never started.
+		for (const auto& [id, progress] : operations)
+		{
+			reply({}, progress);
+		}
+	}
+
+	// The journal knows what was asked, the server's order base tells whether it happened.
+	trade_response plugin::reconcile(const trade_journal::record& entry, std::unordered_set<int>& claimed)
+	{
+		trade_response response{
+			.request_id = entry.request_id,
+			.order_id = 0,
+			.reject_code = RET_ERROR,
+			.reject_message = "Not executed before the plugin restarted"
+		};
+		const auto executed = [&response, &claimed](int order)
+		{
+			claimed.insert(order);
+			response.order_id = order;
+			response.reject_code = RET_OK;
+			response.reject_message = "Executed before the plugin restarted";
+			return response;
+		};
+
+		if (entry.type != trade_request::NEW)
+		{
+			TradeRecord trade{};
+			if (m_mt4server->OrdersGet(entry.order, &trade) == FALSE)
+			{
+				return response;
+			}
+			switch (entry.type)
+			{
+			case trade_request::CLOSE:
+			case trade_request::CANCEL:
+				return trade.close_time != 0 ? executed(trade.order) : response;
+			case trade_request::MODIFY:
+				return trade.close_time == 0 && trade.sl == entry.sl && trade.tp == entry.tp ? executed(trade.order) : response;
+			default:
+				return response;
+			}
+		}
+
+		// A new position has no ticket yet; look for one of the login opened since acceptance that matches
+		// the request, among the open ones first, then among those closed since (stopped out, for instance).
+		const auto cmd = entry.side == trade_request::BUY ? OP_BUY : OP_SELL;
+		const auto find_opened = [&](TradeRecord* found, const int& total)
+		{
+			const heap_array_t<TradeRecord> trades{ found };
+			for (int i = 0; trades != nullptr && i < total; ++i)
+			{
+				const auto& trade = trades[i];
+				// A partly closed position keeps less than the requested volume.
+				if (trade.login == entry.login && trade.cmd == cmd && trade.open_time >= entry.accepted_at && trade.volume <= entry.volume
+					&& claimed.find(trade.order) == claimed.end()
+					&& std::strncmp(trade.symbol, entry.symbol, sizeof(entry.symbol)) == 0
+					&& std::strncmp(trade.comment, entry.comment, sizeof(entry.comment)) == 0)
+				{
+					return trade.order;
+				}
+			}
+			return 0;
+		};
+		const auto now = m_mt4server->TradeTime();
+		int total{ 0 };
+		if (const auto order = find_opened(m_mt4server->OrdersGet(entry.accepted_at, now, &entry.login, 1, &total), total); order != 0)
+		{
+			return executed(order);
+		}
+		if (const auto order = find_opened(m_mt4server->OrdersGetClosed(entry.accepted_at, now, &entry.login, 1, &total), total); order != 0)
+		{
+			return executed(order);
+		}
+		return response;
+	}
+
+	void plugin::handle(const FeedTick* tick)
+	{
+		if (tick != nullptr)
+		{
+			if (auto status = m_nats_conn.publish(m_topic_name_feed_tick, *tick); !status)
+			{
+				m_logger.log_error("Failed to publish feed tick: {}", status.error());
+			}
+			// Accounts crossing a margin level are announced before the next tick.
+			const auto started = std::chrono::steady_clock::now();
+			const auto id = m_registry.symbols.find(bounded(tick->symbol));
+			m_exposure.on_tick(id, tick->bid, tick->ask);
+			std::vector<margin_alert> alerts{};
+			m_equity.on_tick(id, tick->bid, tick->ask, alerts);
+			publish(alerts);
+			m_equity_latency.record(std::chrono::steady_clock::now() - started);
+		}
+	}
+
+	void plugin::handle(const TradeRecord* trade, trade_event::event_kind kind)
+	{
+		if (trade == nullptr)
+		{
+			return;
+		}
+		// Logging here would block the trade thread, losses are counted and reported by the publisher.
+		m_trade_events.push(make_trade_event(*trade, kind));
+	}
+
+	void plugin::handle(const UserRecord* user, bool deleted)
+	{
+		if (user == nullptr)
+		{
+			return;
+		}
+		if (deleted)
+		{
+			m_accounts.erase(user->login);
+		}
+		else if (!m_accounts.upsert(make_account(*user, m_registry)))
+		{
+			m_logger.log_error("Account cache is full, login {} is looked up on the server", user->login);
+		}
+	}
+
+	void plugin::handle(const ConSymbol* symbol, bool deleted)
+	{
+		if (symbol != nullptr && deleted)
+		{
+			// Rows of the symbol drop out of the next snapshot, the view version moved.
+			if (const auto id = m_registry.symbols.find(bounded(symbol->symbol)); id != invalid_id)
+			{
+				m_config.erase_symbol(id, [this, id](const config_view& view) { m_catalog.erase_symbol(view, id); });
+				m_logger.log_info("Symbol '{}' deleted", m_registry.symbols.name(id));
+			}
+		}
+		else if (symbol != nullptr)
+		{
+			if (const auto id = m_registry.symbols.intern(symbol->symbol); id != invalid_id)
+			{
+				auto view = m_config.update(id, *symbol, [&](const config_view& next) { m_catalog.update(next, id, *symbol); });
+				publish_symbol_for_groups(std::move(view), id);
+			}
+			else
+			{
+				m_logger.log_error("Failed to register symbol '{}': registry is full", symbol->symbol);
+			}
+		}
+	}
+
+	void plugin::handle(const ConGroup* group, bool deleted)
+	{
+		if (group != nullptr && deleted)
+		{
+			if (const auto id = m_registry.groups.find(bounded(group->group)); id != invalid_id)
+			{
+				m_config.erase_group(id, [this, id](const config_view& view) { m_catalog.erase_group(view, id); });
+				m_logger.log_info("Group '{}' deleted", m_registry.groups.name(id));
+			}
+		}
+		else if (group != nullptr)
+		{
+			if (const auto id = m_registry.groups.intern(group->group); id != invalid_id)
+			{
+				auto view = m_config.update(id, *group, [&](const config_view& next) { m_catalog.update(next, m_registry, id, *group); });
+				publish_group_symbols(std::move(view), id);
+			}
+			else
+			{
+				m_logger.log_error("Failed to register group '{}': registry is full", group->group);
+			}
+		}
+	}
+
+	void plugin::publish_chart_by_symbol(symbol_id symbol, int digits, int period)
+	{
+		const auto period_index = chart_period_index(period);
+		if (symbol == invalid_id || period_index >= chart_periods_total)
+		{
+			return;
+		}
+		// Skip symbols whose chart is still queued from a previous call.
+		if (m_chart_pending.set(symbol * chart_periods_total + period_index))
+		{
+			return;
+		}
+
+		m_pool->detach_task([this, symbol, digits, period, period_index]()
+		{
+			const auto symbol_name = m_registry.symbols.name(symbol);
+			auto& checkpoint = m_chart_checkpoints[symbol][period_index];
+
+			int count{ 0 };
+			RateInfo* rates = m_mt4server->HistoryQuotes(m_registry.symbols.c_str(symbol), period, &count);
+			if (rates != nullptr && count > 0)
+			{
+				int published_count{ 0 };
+				auto from_time = checkpoint.load(std::memory_order_acquire);
+				if (from_time == chart_point_not_loaded)
+				{
+					from_time = load_chart_point(m_chart_timepoint_dir, symbol_name, period);
+				}
 
-					ConGroupMargin* symbol_margin_sec { nullptr };
-					for (int j = 0; j < group.secmargins_total; ++j)
+				//m_logger.log_info("Publishing chart for symbol: {}, period: {}", symbol_name, period);
+
+				for (int i = count - 1; i >= 0; --i)
+				{
+					const auto& rate = rates[i];
+					// Older candles went out before; leaving the loop still moves the checkpoint to the newest one.
+					if (rate.ctm < from_time)
 					{
-						const auto margin_sec = &group.secmargins[j];
-						if (std::string_view{ margin_sec->symbol } == symbol.symbol) // strcmp_s ? no way
-						{
-							symbol_margin_sec = margin_sec;
-							break;
+						break;
+					}
+					if (should_stop_task(i))
+					{
+						m_chart_pending.reset(symbol * chart_periods_total + period_index);
+						return;
+					}
+
+					if (auto status = m_nats_conn.publish(m_topic_name_mt4_candle,
+						candle{
+							.symbol = symbol_name,
+							.ts = rate.ctm,
+							.open = tools::int_price_to_double(rate.open, digits),
+							.high = tools::int_price_to_double(rate.high, digits),
+							.low = tools::int_price_to_double(rate.low, digits),
+							.close = tools::int_price_to_double(rate.close, digits)
 						}
+					); !status)
+					{
+						m_logger.log_error("Failed to publish chart candle for symbol: {}, period: {}: {}", symbol_name, period, status.error());
+					}
+					else
+					{
+						++published_count;
 					}
+				}
+
+				checkpoint.store(rates[count - 1].ctm, std::memory_order_release);
+				if (!m_state.is_open())
+				{
+					save_chart_point(m_chart_timepoint_dir, symbol_name, rates[count - 1].ctm, period);
+				}
+			}
+			m_chart_pending.reset(symbol * chart_periods_total + period_index);
+
+			//m_logger.log_info("Finished publishing chart for symbol: {} period: {} candles published: {}", symbol_name, period, published_count);
+		}, BS::pr::low);
+	}
 
-					if (auto result = make_group_symbol(group, symbol, symbol_margin_sec); result)
+	void plugin::publish_chart()
+	{
+		const auto view = m_config.view();
+		for (symbol_id id = 0; id < view->symbols().size(); ++id)
+		{
+			if (const auto symbol = view->symbol(id); symbol != nullptr)
+			{
+				publish_chart_by_symbol(id, symbol->digits, PERIOD_M1);
+			}
+		}
+	}
+
+	bool plugin::publish(const group_symbol& row)
+	{
+		if (auto status = m_nats_conn.publish(m_topic_name_con_symbol, row); !status)
+		{
+			m_logger.log_error("Failed to publish symbol '{}' for group '{}': {}", row.symbol, row.account_group, status.error());
+			return false;
+		}
+		return true;
+	}
+
+	// Bounds how far a bulk publication runs ahead of the connection.
+	void plugin::flush_published()
+	{
+		if (auto flushed = m_nats_conn.flush(m_warmup_flush_timeout); !flushed)
+		{
+			m_logger.log_error("Failed to flush symbols batch: {}", flushed.error());
+		}
+	}
+
+	void plugin::publish_group_symbols(config_store::view_ptr_t view, group_id id)
+	{
+		++m_groups_publishing[id];
+		m_pool->detach_task([this, view = std::move(view), id]()
+		{
+			const auto group = view->group(id);
+			const auto masks = view->masks(id);
+			if (group == nullptr || masks == nullptr)
+			{
+				--m_groups_publishing[id];
+				return;
+			}
+			m_logger.log_info("Publishing {} symbols for group: {}", masks->visible.count(), group->group);
+
+			int i = 0;
+			const auto completed = masks->visible.for_each([&](size_t symbol_index)
+			{
+				if (should_stop_task(i++)) return false;
+
+				const auto symbol = view->symbol(static_cast<symbol_id>(symbol_index));
+				publish(make_group_symbol(*group, *masks, static_cast<symbol_id>(symbol_index), *symbol, view->version()));
+				return true;
+			});
+			if (completed)
+			{
+				--m_groups_publishing[id];
+			}
+		}, BS::pr::low);
+	}
+
+	void plugin::publish_symbol_for_groups(config_store::view_ptr_t view, symbol_id id)
+	{
+		++m_symbols_publishing[id];
+		m_pool->detach_task([this, view = std::move(view), id]()
+			{
+				const auto symbol = view->symbol(id);
+				if (symbol == nullptr)
+				{
+					--m_symbols_publishing[id];
+					return;
+				}
+				m_logger.log_info("Publishing symbol for groups: {}", symbol->symbol);
+
+				int i = 0;
+				for (group_id group_index = 0; group_index < view->groups().size(); ++group_index)
+				{
+					if (should_stop_task(i++)) return;
+					if (!view->is_visible(group_index, id)) continue;
+
+					publish(make_group_symbol(*view->group(group_index), *view->masks(group_index), id, *symbol, view->version()));
+				}
+				--m_symbols_publishing[id];
+			}, BS::pr::low);
+	}
+
+	void plugin::publish_all_groups_with_symbols()
+	{
+		const auto view = m_config.view();
+		std::vector<group_id> groups{};
+		for (group_id id = 0; id < view->groups().size(); ++id)
+		{
+			if (view->group(id) != nullptr)
+			{
+				groups.push_back(id);
+			}
+		}
+		publish_warm_up(view, groups, {});
+	}
+
+	void plugin::warm_up()
+	{
+		const auto previous = m_state.previous();
+		if (previous == nullptr)
+		{
+			publish_all_groups_with_symbols();
+			return;
+		}
+
+		const auto view = m_config.view();
+		const auto saved_symbols = saved_entries(previous->symbols);
+		const auto saved_groups = saved_entries(previous->groups);
+
+		std::vector<symbol_id> changed_symbols{};
+		for (symbol_id id = 0; id < view->symbols().size(); ++id)
+		{
+			if (const auto symbol = view->symbol(id); symbol != nullptr)
+			{
+				const auto saved = saved_symbols.find(bounded(symbol->symbol));
+				if (saved == saved_symbols.end() || saved->second->hash != hash_symbol(*symbol))
+				{
+					changed_symbols.push_back(id);
+				}
+			}
+		}
+		std::vector<group_id> changed_groups{};
+		for (group_id id = 0; id < view->groups().size(); ++id)
+		{
+			if (const auto group = view->group(id); group != nullptr)
+			{
+				const auto saved = saved_groups.find(bounded(group->group));
+				if (saved == saved_groups.end() || saved->second->hash != hash_group(*group))
+				{
+					changed_groups.push_back(id);
+				}
+			}
+		}
+
+		m_logger.log_info("Warm restart from state saved at {}: {} of {} symbols and {} of {} groups changed",
+			previous->saved_at, changed_symbols.size(), saved_symbols.size(), changed_groups.size(), saved_groups.size());
+		publish_warm_up(view, changed_groups, changed_symbols);
+	}
+
+	void plugin::publish_warm_up(config_store::view_ptr_t view, const std::vector<group_id>& full_groups, const std::vector<symbol_id>& changed_symbols)
+	{
+		struct work_item
+		{
+			group_id	id;
+			bool		full;
+		};
+		struct warm_up_state
+		{
+			const std::chrono::steady_clock::time_point	started{ std::chrono::steady_clock::now() };
+			std::atomic<size_t>							partitions_left{ 0 };
+			std::atomic<size_t>							published{ 0 };
+			std::atomic<bool>							stopped{ false };
+		};
+
+		// A changed symbol has a row in every group, so then every group is visited.
+		auto work = std::make_shared<std::vector<work_item>>();
+		if (changed_symbols.empty())
+		{
+			for (const auto id : full_groups)
+			{
+				work->push_back({ id, true });
+			}
+		}
+		else
+		{
+			std::vector<bool> full(view->groups().size(), false);
+			for (const auto id : full_groups)
+			{
+				full[id] = true;
+			}
+			for (group_id id = 0; id < view->groups().size(); ++id)
+			{
+				if (view->group(id) != nullptr)
+				{
+					work->push_back({ id, full[id] });
+				}
+			}
+		}
+		auto changed = std::make_shared<symbol_set>();
+		for (const auto id : changed_symbols)
+		{
+			changed->set(id);
+		}
+
+		for (const auto id : full_groups)
+		{
+			++m_groups_publishing[id];
+		}
+		for (const auto id : changed_symbols)
+		{
+			++m_symbols_publishing[id];
+		}
+
+		// Every group costs about the same (one row per symbol), so round-robin keeps the workers even.
+		const auto partitions = std::max<size_t>(1, std::min<size_t>(m_pool->get_thread_count(), work->size()));
+		auto state = std::make_shared<warm_up_state>();
+		state->partitions_left.store(partitions);
+
+		m_logger.log_info("Publishing {} groups ({} in full) and {} changed symbols on {} workers",
+			work->size(), full_groups.size(), changed_symbols.size(), partitions);
+
+		for (size_t partition = 0; partition < partitions; ++partition)
+		{
+			m_pool->detach_task([this, view, work, changed, state, partition, partitions]()
+			{
+				size_t published{ 0 };
+				int iteration{ 0 };
+				for (size_t i = partition; i < work->size() && !state->stopped; i += partitions)
+				{
+					const auto& item = (*work)[i];
+					const auto group = view->group(item.id);
+					const auto& masks = *view->masks(item.id);
+					const auto publish_row = [&](size_t symbol_index)
+					{
+						if (should_stop_task(iteration++))
+						{
+							state->stopped = true;
+							return false;
+						}
+						const auto id = static_cast<symbol_id>(symbol_index);
+						if (publish(make_group_symbol(*group, masks, id, *view->symbol(id), view->version()))
+							&& ++published % m_warmup_batch_size == 0)
+						{
+							flush_published();
+						}
+						return true;
+					};
+
+					if (item.full)
 					{
-						if (auto status = m_nats_conn.publish(m_topic_name_con_symbol, *result); !status)
+						// A stopped group stays marked, so the saved state has it republished next time.
+						if (masks.visible.for_each(publish_row))
 						{
-							m_logger.log_error("Failed to publish symbol for group '{}': {}", group.group, status.error());
+							--m_groups_publishing[item.id];
 						}
 					}
+					else
+					{
+						(masks.visible & *changed).for_each(publish_row);
+					}
 				}
-			}, BS::pr::low);
+				flush_published();
+
+				state->published += published;
+				if (state->partitions_left.fetch_sub(1) != 1 || state->stopped)
+				{
+					return;
+				}
+				changed->for_each([this](size_t id) { --m_symbols_publishing[id]; return true; });
+
+				const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - state->started);
+				m_logger.log_info("Published {} group symbols for version {} in {} ms", state->published.load(), view->version(), elapsed.count());
+
+				if (auto status = m_nats_conn.publish(m_topic_name_symbols_ready,
+					symbols_ready{
+						.version = view->version(),
+						.groups = work->size(),
+						.published = state->published.load(),
+						.elapsed_ms = elapsed.count()
+					}
+				); !status)
+				{
+					m_logger.log_error("Failed to publish symbols ready marker: {}", status.error());
+				}
+			}, BS::pr::normal);
+		}
 	}
 
-	void plugin::publish_all_groups_with_symbols()
+	std::vector<group_symbol> plugin::collect_group_symbols(const config_view& view)
 	{
-		ConGroup group{};
-		for (int i = 0; m_mt4server->GroupsNext(i, &group); ++i)
+		size_t total{ 0 };
+		for (const auto& masks : view.masks())
+		{
+			total += masks != nullptr ? masks->visible.count() : 0;
+		}
+
+		std::vector<group_symbol> rows{};
+		rows.reserve(total);
+		for (group_id id = 0; id < view.groups().size(); ++id)
 		{
-			publish_group_symbols(group);
+			const auto group = view.group(id);
+			const auto masks = view.masks(id);
+			if (group == nullptr || masks == nullptr) continue;
+
+			masks->visible.for_each([&](size_t symbol_index)
+			{
+				const auto symbol_id = static_cast<mt4::symbol_id>(symbol_index);
+				rows.push_back(make_group_symbol(*group, *masks, symbol_id, *view.symbol(symbol_id), view.version()));
+				return true;
+			});
 		}
+		return rows;
 	}
 
 	bool plugin::should_stop_task(int iteration)
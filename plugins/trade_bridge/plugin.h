@@ -1,6 +1,13 @@
 #pragma once
 
+#include <array>
+#include <atomic>
 #include <memory>
+#include <mutex>
+#include <span>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 #include <filesystem>
 
 #include <BS_thread_pool.hpp>
@@ -10,12 +17,37 @@
 #include "json.h"
 #include "nats.h"
 #include "marshaling.h"
+#include "models.h"
+#include "symbols_snapshot.h"
+#include "registry.h"
+#include "config_store.h"
+#include "shm_catalog.h"
+#include "state_file.h"
+#include "metrics.h"
+#include "trade_executor.h"
+#include "idempotency_store.h"
+#include "admission_control.h"
+#include "trade_journal.h"
+#include "sharded_executor.h"
+#include "timer_wheel.h"
+#include "correlation_store.h"
+#include "trade_basket.h"
+#include "mass_operation.h"
+#include "trade_events.h"
+#include "position_index.h"
+#include "equity_engine.h"
+#include "exposure_book.h"
+#include "account_cache.h"
+#include "export_job.h"
+#include "quote_ingest.h"
 
 struct CServerInterface;
 struct ConGroup;
 struct ConGroupMargin;
 struct ConSymbol;
 struct FeedTick;
+struct TradeRecord;
+struct UserRecord;
 
 namespace mt4
 {
@@ -39,33 +71,162 @@ namespace mt4
 	public:
 		using uptr_t = std::unique_ptr<plugin>;
 
+		static constexpr size_t chart_periods_total = 9;
+		static_assert(chart_periods_total == state_file::chart_periods_total);
+
+		struct config
+		{
+			std::string		server_name;
+			std::string		nats_url;
+			size_t			pool_size;
+			time_t			last_chart_sync_time;
+			std::string		catalog_name;
+			size_t			warmup_batch_size;
+			size_t			warmup_flush_timeout_ms;
+			std::string		state_file;
+			size_t			state_save_interval_s;
+			size_t			trade_shards;
+			size_t			trade_queue_capacity;
+			int				trade_first_cpu;
+			bool			trade_validation_parity;
+			size_t			idempotency_memory_kb;
+			size_t			idempotency_ttl_s;
+			size_t			trade_max_in_flight;
+			size_t			trade_max_queue_delay_ms;
+			size_t			trade_max_bypass;
+			size_t			trade_request_timeout_ms;
+			size_t			trade_basket_max_legs;
+			size_t			mass_trade_window;
+			size_t			mass_trade_progress_ms;
+			size_t			trade_event_queue;
+			size_t			trade_event_batch;
+			size_t			trade_event_flush_ms;
+			size_t			positions_max_page;
+			size_t			exposure_publish_ms;
+			size_t			account_cache_capacity;
+			std::string		export_dir;
+			size_t			export_workers;
+			size_t			export_backoff_ms;
+			size_t			export_max_slices;
+			bool			quote_ingest;
+			std::string		quote_ingest_bank;
+			std::string		journal_file;
+			size_t			journal_records;
+			size_t			journal_commit_interval_us;
+			size_t			journal_commit_records;
+			size_t			metrics_interval_s;
+			size_t			timer_resolution_ms;
+		};
+
+		~plugin();
+
 		static tl::expected<plugin::uptr_t, std::string> initialize(CServerInterface* mt4server, const std::string_view plugin_name);
 
 		void handle(const FeedTick* tick);
-		void handle(const ConSymbol* symbol);
-		void handle(const ConGroup* group);
+		void handle(const ConSymbol* symbol, bool deleted);
+		void handle(const ConGroup* group, bool deleted);
+		// Called on the server's trade threads, only queues the event.
+		void handle(const TradeRecord* trade, trade_event::event_kind kind);
+		void handle(const UserRecord* user, bool deleted);
 
 		void publish_chart();
 		void publish_all_groups_with_symbols();
 
+		// Publishes only what changed since the saved state, or everything on the first run.
+		void warm_up();
+		void save_state();
+
 	private:
+		struct trade_task
+		{
+			size_t									priority;
+			trade_request							request;
+			correlation_store::handle				pending;
+			timer_wheel::handle						deadline;
+			pending_basket::ptr_t					basket;			// null for a single request
+			mass_operation::ptr_t					mass;			// set for a mass operation target, which has no pending entry
+			uint32_t								leg;
+			std::chrono::steady_clock::time_point	received;
+		};
+
 		plugin(
 			const std::string_view plugin_name,
-			const std::string_view server_name,
-			const std::string_view nats_url,
-			CServerInterface* mt4server,
-			size_t pool_size
+			const config& cfg,
+			CServerInterface* mt4server
 		) noexcept;
 
 		tl::expected<void, std::string> connect_to_nats(const std::string_view nats_url);
-		tl::expected<void, std::string> nats_subscribe_to_trade_request(const std::string_view server_name);
+		tl::expected<void, std::string> nats_subscribe_to_trade_request();
+		tl::expected<void, std::string> nats_subscribe_to_trade_basket();
+		tl::expected<void, std::string> nats_subscribe_to_mass_trade();
+		tl::expected<void, std::string> nats_subscribe_to_snapshot_request();
+		tl::expected<void, std::string> nats_subscribe_to_positions_request();
+		tl::expected<void, std::string> nats_subscribe_to_exposure_request();
+		tl::expected<void, std::string> nats_subscribe_to_export();
+		tl::expected<void, std::string> nats_subscribe_to_quotes();
+
+		// Admits a request or a basket leg and queues it on its login's worker, answering it right away when that fails.
+		void submit_trade(trade_request&& request, const std::string_view reply_to, const pending_basket::ptr_t& basket, uint32_t leg,
+			std::chrono::steady_clock::time_point received);
+		trade_response on_trade_request(const trade_request& request, std::chrono::steady_clock::time_point received);
+		trade_response execute_journaled(const trade_request& request, int operation_id = 0);
+		// Replies to a single request, or completes a leg and replies once its basket is complete.
+		void respond(const std::string_view reply_to, const pending_basket::ptr_t& basket, uint32_t leg, trade_response&& response);
+		void reply(const std::string_view reply_to, const trade_response& response);
+		void reply(const std::string_view reply_to, const trade_basket_response& response);
+		void reply(const std::string_view reply_to, const mass_trade_progress& progress);
+		void reply(const std::string_view reply_to, const export_progress& progress);
+		trade_response reject_busy(int request_id, std::string&& reason);
+		// Answers a request still queued at its deadline, a worker that claimed it first wins.
+		void on_trade_deadline(correlation_store::handle pending, int request_id, const pending_basket::ptr_t& basket, uint32_t leg);
+
+		void start_mass_trade(const mass_trade_request& request, const std::string& reply_to, std::chrono::steady_clock::time_point received);
+		void submit_mass_next(const mass_operation::ptr_t& operation);
+		void submit_mass(const mass_operation::ptr_t& operation, size_t index);
+		void on_mass_result(const mass_operation::ptr_t& operation, size_t index, const trade_response& response);
+
+		void start_export(export_request&& request, const std::string& reply_to);
+		void submit_export_next(const export_job::ptr_t& job);
+		// A slice that finds trade requests in flight is deferred once by the backoff interval.
+		void run_export_slice(const export_job::ptr_t& job, uint64_t slice, bool deferred);
+		tl::expected<size_t, std::string> export_slice(const export_job& job, uint64_t slice);
+		void finish_export(const export_job::ptr_t& job);
 
-		void on_trade_request(trade_request& request);
+		// Settles the requests the previous run accepted but never answered.
+		void recover_trades();
+		// Claimed holds the tickets earlier entries were matched to, a ticket answers one request only.
+		trade_response reconcile(const trade_journal::record& entry, std::unordered_set<int>& claimed);
 
-		void publish_chart_by_symbol(const ConSymbol& symbol, int period);
+		void log_metrics();
+		void publish_trade_events();
+		// Rebuilds the open positions index and the equity engine from every account's open orders.
+		void seed_positions();
+		void seed_positions(std::span<const UserRecord> users);
+		// Re-anchors an account's equity to the server's margin figures.
+		void anchor_equity(const UserRecord& record, const config_view& view, std::vector<margin_alert>& alerts);
+		void publish(const std::vector<margin_alert>& alerts);
+		void publish_exposure();
+		// Fills the account cache from the startup sweep of every account.
+		void seed_accounts(std::span<const UserRecord> users);
+		group_id login_group(int login) const;
 
-		void publish_group_symbols(const ConGroup& group);
-		void publish_symbol_for_groups(const ConSymbol& symbol);
+		void load_config();
+
+		void publish_chart_by_symbol(symbol_id symbol, int digits, int period);
+
+		// A row on the symbol topic, false when it didn't go out.
+		bool publish(const group_symbol& row);
+		void flush_published();
+
+		void publish_group_symbols(config_store::view_ptr_t view, group_id id);
+		void publish_symbol_for_groups(config_store::view_ptr_t view, symbol_id id);
+
+		// Full groups get every symbol, the other groups only the changed symbols.
+		void publish_warm_up(config_store::view_ptr_t view, const std::vector<group_id>& full_groups, const std::vector<symbol_id>& changed_symbols);
+
+		void restore_state();
+
+		static std::vector<group_symbol> collect_group_symbols(const config_view& view);
 
 		bool should_stop_task(int iteration);
 
@@ -79,7 +240,77 @@ namespace mt4
 		const std::string				m_topic_name_feed_tick;
 		const std::string				m_topic_name_con_symbol;
 		const std::string				m_topic_name_mt4_candle;
+		const std::string				m_topic_name_symbols_snapshot;
+		const std::string				m_topic_name_symbols_ready;
+		const std::string				m_topic_name_trade_request;
+		const std::string				m_topic_name_trade_response;
+		const std::string				m_topic_name_trade_stats;
+		const std::string				m_topic_name_trade_basket;
+		const std::string				m_topic_name_trade_basket_response;
+		const std::string				m_topic_name_trade_mass;
+		const std::string				m_topic_name_trade_mass_progress;
+		const std::string				m_topic_name_trade_events;
+		const std::string				m_topic_name_positions;
+		const std::string				m_topic_name_positions_snapshot;
+		const std::string				m_topic_name_margin_alerts;
+		const std::string				m_topic_name_exposure;
+		const std::string				m_topic_name_exposure_snapshot;
+		const std::string				m_topic_name_export;
+		const std::string				m_topic_name_export_progress;
+		const std::string				m_topic_name_export_chunks;		// prefix, the export id is appended
+		const std::string				m_topic_name_quotes;
+
+		const size_t					m_warmup_batch_size;
+		const std::chrono::milliseconds	m_warmup_flush_timeout;
+
+		symbols_snapshot				m_symbols_snapshot;
 
 		const std::filesystem::path		m_chart_timepoint_dir;
+
+		registry						m_registry;
+		config_store					m_config;
+		shm_catalog						m_catalog;
+		state_file						m_state;
+		const std::chrono::seconds		m_state_save_interval;
+		// Publications queued but not finished, such entries are saved as unpublished.
+		std::array<std::atomic<uint32_t>, max_groups> m_groups_publishing;
+		std::array<std::atomic<uint32_t>, max_symbols> m_symbols_publishing;
+
+		const std::chrono::seconds		m_metrics_interval;
+		trade_metrics					m_trade_metrics;
+		idempotency_store				m_idempotency;
+		admission_control				m_admission;
+		correlation_store				m_pending;
+		const std::chrono::milliseconds	m_trade_request_timeout;
+		const size_t					m_trade_basket_max_legs;
+		const size_t					m_mass_trade_window;
+		const std::chrono::milliseconds	m_mass_trade_progress_interval;
+		trade_journal					m_journal;
+		trade_event_stream				m_trade_events;
+		position_index					m_positions;
+		const size_t					m_positions_max_page;
+		position_deltas					m_position_deltas;		// publisher only
+		equity_engine					m_equity;
+		latency_histogram				m_equity_latency;		// tick to margin alerts
+		exposure_book					m_exposure;
+		std::atomic<bool>				m_exposure_publishing{ false };
+		account_cache					m_accounts;
+		const std::filesystem::path		m_export_dir;
+		const size_t					m_export_workers;
+		const std::chrono::milliseconds	m_export_backoff;
+		const uint64_t					m_export_max_slices;
+		std::mutex						m_exports_mutex;
+		std::unordered_set<std::string>	m_exports;				// ids of the running exports
+		quote_ingest					m_quotes;
+		trade_executor					m_trade_executor;
+		std::array<std::array<std::atomic<time_t>, chart_periods_total>, max_symbols> m_chart_checkpoints;
+		atomic_bitset<max_symbols * chart_periods_total> m_chart_pending;
+
+		// Request deadlines and the periodic duties, its callbacks use the members above.
+		timer_wheel						m_timers;
+
+		// Trade requests run apart from the publishing pool, so bulk publication can't delay them.
+		// Declared last: its workers use the members above and are joined first.
+		sharded_executor<trade_task, trade_priority_levels>	m_trade_shards;
 	};
 }
\ No newline at end of file
@@ -0,0 +1,132 @@
+#include "position_index.h"
+
+#include <algorithm>
+#include <ctime>
+#include <mutex>
+
+#include "mt4.h"
+
+namespace mt4
+{
+	void position_index::reset(std::vector<trade_event>&& orders)
+	{
+		std::unique_lock lock{ m_mutex };
+		m_orders.clear();
+		m_logins.clear();
+		for (auto& order : orders)
+		{
+			insert_ticket(order.login, order.order);
+			m_orders.insert_or_assign(order.order, std::move(order));
+		}
+		// Wall-clock based so epochs stay unique across restarts, bumped when two resets share a second.
+		m_epoch = std::max<int64_t>(static_cast<int64_t>(std::time(nullptr)), m_epoch + 1);
+		m_sequence = 0;
+	}
+
+	std::optional<position_delta> position_index::apply(const trade_event& event)
+	{
+		// Balance and credit operations never stay open.
+		if (event.cmd < OP_BUY || event.cmd > OP_SELL_STOP)
+		{
+			return std::nullopt;
+		}
+
+		std::unique_lock lock{ m_mutex };
+		switch (event.kind)
+		{
+		case trade_event::OPENED:
+		case trade_event::MODIFIED:
+		case trade_event::ACTIVATED:
+			if (const auto [it, inserted] = m_orders.insert_or_assign(event.order, event); inserted)
+			{
+				insert_ticket(event.login, event.order);
+			}
+			return position_delta{ .sequence = ++m_sequence, .removed = false, .position = event };
+
+		case trade_event::CLOSED:
+		case trade_event::DELETED:
+		case trade_event::CLOSED_BY:
+			if (m_orders.erase(event.order) == 0)
+			{
+				return std::nullopt;
+			}
+			erase_ticket(event.login, event.order);
+			return position_delta{ .sequence = ++m_sequence, .removed = true, .position = event };
+		}
+		return std::nullopt;
+	}
+
+	positions_page position_index::page(const positions_request& request) const
+	{
+		std::shared_lock lock{ m_mutex };
+		positions_page result{ .epoch = m_epoch, .sequence = m_sequence, .next = 0, .positions = {} };
+		result.positions.reserve(std::min(request.limit, m_orders.size()));
+
+		if (request.login != 0)
+		{
+			const auto login = m_logins.find(request.login);
+			if (login == m_logins.end())
+			{
+				return result;
+			}
+			const auto& tickets = login->second;
+			for (auto it = std::upper_bound(tickets.begin(), tickets.end(), request.after); it != tickets.end(); ++it)
+			{
+				if (result.positions.size() == request.limit)
+				{
+					result.next = result.positions.back().order;
+					break;
+				}
+				result.positions.push_back(m_orders.at(*it));
+			}
+			return result;
+		}
+
+		for (auto it = m_orders.upper_bound(request.after); it != m_orders.end(); ++it)
+		{
+			if (result.positions.size() == request.limit)
+			{
+				result.next = result.positions.back().order;
+				break;
+			}
+			result.positions.push_back(it->second);
+		}
+		return result;
+	}
+
+	int64_t position_index::epoch() const
+	{
+		std::shared_lock lock{ m_mutex };
+		return m_epoch;
+	}
+
+	size_t position_index::size() const
+	{
+		std::shared_lock lock{ m_mutex };
+		return m_orders.size();
+	}
+
+	void position_index::insert_ticket(int login, int ticket)
+	{
+		auto& tickets = m_logins[login];
+		tickets.insert(std::upper_bound(tickets.begin(), tickets.end(), ticket), ticket);
+	}
+
+	void position_index::erase_ticket(int login, int ticket)
+	{
+		const auto login_it = m_logins.find(login);
+		if (login_it == m_logins.end())
+		{
+			return;
+		}
+		auto& tickets = login_it->second;
+		if (const auto it = std::lower_bound(tickets.begin(), tickets.end(), ticket); it != tickets.end() && *it == ticket)
+		{
+			tickets.erase(it);
+		}
+		if (tickets.empty())
+		{
+			m_logins.erase(login_it);
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <shared_mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "models.h"
+
+namespace mt4
+{
+	// Open positions and pending orders by ticket and by login, so risk systems can page
+	// through them without asking the server. Seeded from a sweep of OrdersGetOpen and kept
+	// current by the trade event publisher, which is its only writer; every change gets the
+	// next sequence number so a snapshot plus the following deltas give the current state.
+	class position_index
+	{
+	public:
+		// Replaces the content and starts a new epoch, clients holding the old one must resync.
+		void reset(std::vector<trade_event>&& orders);
+
+		// Publisher only. Nothing for events that don't change the set of open orders.
+		std::optional<position_delta> apply(const trade_event& event);
+
+		positions_page page(const positions_request& request) const;
+
+		int64_t epoch() const;
+		size_t size() const;
+
+	private:
+		void insert_ticket(int login, int ticket);
+		void erase_ticket(int login, int ticket);
+
+		mutable std::shared_mutex					m_mutex;
+		std::map<int, trade_event>					m_orders;		// by ticket, pages walk it in order
+		std::unordered_map<int, std::vector<int>>	m_logins;		// sorted tickets of each login
+		int64_t										m_epoch{ 0 };
+		uint64_t									m_sequence{ 0 };
+	};
+}
\ No newline at end of file
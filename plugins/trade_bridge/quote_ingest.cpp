@@ -0,0 +1,164 @@
+#include "quote_ingest.h"
+
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+
+#include "mt4.h"
+
+namespace
+{
+	std::array<char, 32> to_bank(std::string_view name) noexcept
+	{
+		std::array<char, 32> bank{};
+		name.copy(bank.data(), std::min(name.size(), bank.size() - 1));
+		return bank;
+	}
+}
+
+namespace mt4
+{
+	quote_ingest::quote_ingest(CServerInterface* mt4server, const registry& ids, std::string_view bank)
+		: m_mt4server{ mt4server }
+		, m_registry{ ids }
+		, m_bank{ to_bank(bank) }
+		, m_slots(max_symbols, pending_tick{})
+	{
+		m_ready.reserve(max_symbols);
+	}
+
+	quote_ingest::~quote_ingest()
+	{
+		stop();
+	}
+
+	void quote_ingest::start()
+	{
+		if (!m_thread.joinable())
+		{
+			m_thread = std::thread{ [this]() { run(); } };
+		}
+	}
+
+	void quote_ingest::stop()
+	{
+		{
+			std::lock_guard lock{ m_mutex };
+			m_stopping = true;
+		}
+		m_ready_cv.notify_one();
+		if (m_thread.joinable())
+		{
+			m_thread.join();
+		}
+	}
+
+	void quote_ingest::push(const quote_batch& batch, std::chrono::steady_clock::time_point received)
+	{
+		const auto bank = batch.source.empty() ? m_bank : to_bank(batch.source);
+		uint64_t rejected{ 0 };
+		uint64_t conflated{ 0 };
+		bool wake{ false };
+		{
+			std::lock_guard lock{ m_mutex };
+			for (const auto& quote : batch.quotes)
+			{
+				const auto id = m_registry.symbols.find(quote.symbol);
+				if (id >= max_symbols || !(quote.bid > 0.0) || quote.ask < quote.bid)
+				{
+					++rejected;
+					continue;
+				}
+				auto& pending = m_slots[id];
+				if (pending.waiting)
+				{
+					++conflated;
+				}
+				else
+				{
+					wake = wake || m_ready.empty();
+					m_ready.push_back(id);
+				}
+				pending = pending_tick{ .bid = quote.bid, .ask = quote.ask, .time = quote.time, .bank = bank, .received = received, .waiting = true };
+			}
+		}
+		if (wake)
+		{
+			m_ready_cv.notify_one();
+		}
+		m_received.fetch_add(batch.quotes.size(), std::memory_order_relaxed);
+		m_rejected.fetch_add(rejected, std::memory_order_relaxed);
+		m_conflated.fetch_add(conflated, std::memory_order_relaxed);
+	}
+
+	quote_ingest::counters quote_ingest::drain() noexcept
+	{
+		return counters{
+			.received = m_received.exchange(0, std::memory_order_relaxed),
+			.applied = m_applied.exchange(0, std::memory_order_relaxed),
+			.conflated = m_conflated.exchange(0, std::memory_order_relaxed),
+			.rejected = m_rejected.exchange(0, std::memory_order_relaxed),
+			.blocks = m_blocks.exchange(0, std::memory_order_relaxed),
+		};
+	}
+
+	void quote_ingest::run()
+	{
+		constexpr size_t block_size = sizeof(FeedData::ticks) / sizeof(FeedTick);
+		std::vector<symbol_id> symbols{};
+		std::vector<pending_tick> ticks{};
+		symbols.reserve(max_symbols);
+		ticks.reserve(max_symbols);
+		const auto data = std::make_unique<FeedData>();
+
+		for (;;)
+		{
+			{
+				std::unique_lock lock{ m_mutex };
+				m_ready_cv.wait(lock, [this]() { return m_stopping || !m_ready.empty(); });
+				if (m_stopping)
+				{
+					return;
+				}
+				// Quotes arriving while the server takes these wait for the next round, one per symbol.
+				symbols.swap(m_ready);
+				ticks.clear();
+				for (const auto id : symbols)
+				{
+					ticks.push_back(m_slots[id]);
+					m_slots[id].waiting = false;
+				}
+			}
+
+			const auto now = static_cast<int64_t>(std::time(nullptr));
+			for (size_t first = 0; first < symbols.size(); first += block_size)
+			{
+				const auto count = std::min(block_size, symbols.size() - first);
+				std::memset(data.get(), 0, sizeof(FeedData));
+				for (size_t i = 0; i < count; ++i)
+				{
+					const auto& source = ticks[first + i];
+					auto& tick = data->ticks[i];
+					const auto name = m_registry.symbols.name(symbols[first + i]);
+					name.copy(tick.symbol, std::min(name.size(), sizeof(tick.symbol) - 1));
+					std::memcpy(tick.bank, source.bank.data(), std::min(source.bank.size(), sizeof(tick.bank)));
+					tick.bank[sizeof(tick.bank) - 1] = '\0';
+					tick.ctm = static_cast<__time32_t>(source.time != 0 ? source.time : now);
+					tick.bid = source.bid;
+					tick.ask = source.ask;
+				}
+				data->ticks_count = static_cast<int>(count);
+				m_mt4server->HistoryAddTick(data.get());
+
+				const auto applied = std::chrono::steady_clock::now();
+				for (size_t i = 0; i < count; ++i)
+				{
+					m_latency.record(applied - ticks[first + i].received);
+				}
+				m_applied.fetch_add(count, std::memory_order_relaxed);
+				m_blocks.fetch_add(1, std::memory_order_relaxed);
+			}
+			symbols.clear();
+		}
+	}
+}
\ No newline at end of file
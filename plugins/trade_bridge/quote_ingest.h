@@ -0,0 +1,83 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "metrics.h"
+#include "models.h"
+#include "registry.h"
+
+struct CServerInterface;
+
+namespace mt4
+{
+	// Feeds external quotes to the server with HistoryAddTick from a thread of its own. Each
+	// symbol holds at most one quote waiting for that thread: a newer quote replaces it, so when
+	// the server falls behind it gets the latest price of every symbol instead of a backlog.
+	// Waiting quotes are handed over in FeedData blocks of up to 32 ticks.
+	class quote_ingest
+	{
+	public:
+		struct counters
+		{
+			uint64_t	received;
+			uint64_t	applied;
+			uint64_t	conflated;		// replaced before the server got them
+			uint64_t	rejected;		// unknown symbol or invalid prices
+			uint64_t	blocks;
+		};
+
+		// Bank is the FeedTick::bank of batches without a source.
+		quote_ingest(CServerInterface* mt4server, const registry& ids, std::string_view bank);
+		~quote_ingest();
+
+		void start();
+		void stop();
+
+		// NATS delivery thread.
+		void push(const quote_batch& batch, std::chrono::steady_clock::time_point received);
+
+		// Cover the interval since the previous call.
+		counters drain() noexcept;
+		latency_histogram::summary latency() noexcept { return m_latency.drain(); }
+
+	private:
+		struct pending_tick
+		{
+			double									bid;
+			double									ask;
+			int64_t									time;
+			std::array<char, 32>					bank;
+			std::chrono::steady_clock::time_point	received;
+			bool									waiting;
+		};
+
+		void run();
+
+		CServerInterface*						m_mt4server;
+		const registry&							m_registry;
+		const std::array<char, 32>				m_bank;
+
+		std::mutex								m_mutex;
+		std::condition_variable					m_ready_cv;
+		std::vector<pending_tick>				m_slots;		// by symbol id
+		std::vector<symbol_id>					m_ready;		// symbols with a waiting quote, in arrival order
+		bool									m_stopping{ false };
+
+		std::atomic<uint64_t>					m_received{ 0 };
+		std::atomic<uint64_t>					m_applied{ 0 };
+		std::atomic<uint64_t>					m_conflated{ 0 };
+		std::atomic<uint64_t>					m_rejected{ 0 };
+		std::atomic<uint64_t>					m_blocks{ 0 };
+		latency_histogram						m_latency;		// arrival to HistoryAddTick returning
+
+		std::thread								m_thread;
+	};
+}
\ No newline at end of file
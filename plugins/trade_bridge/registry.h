@@ -0,0 +1,219 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace mt4
+{
+	using symbol_id = uint16_t;
+	using group_id = uint16_t;
+
+	static constexpr uint16_t invalid_id = std::numeric_limits<uint16_t>::max();
+
+	static constexpr size_t max_symbols = 1024;	// MAX_SYMBOLS of the server API
+	static constexpr size_t max_groups = 4096;
+
+	// Assigns dense ids to names. Ids are never reused, so they stay valid for the lifetime
+	// of the process and can index flat arrays. Names are resolved to ids under a shared lock,
+	// ids are resolved back to names without any locking.
+	template<size_t Capacity, size_t NameSize>
+	class interner
+	{
+		struct string_hash
+		{
+			using is_transparent = void;
+			size_t operator() (const std::string_view value) const noexcept
+			{
+				return std::hash<std::string_view>{}(value);
+			}
+		};
+
+	public:
+		static constexpr size_t capacity = Capacity;
+
+		uint16_t intern(const std::string_view name)
+		{
+			if (const auto id = find(name); id != invalid_id)
+			{
+				return id;
+			}
+
+			std::unique_lock lock{ m_mutex };
+			if (auto it = m_ids.find(name); it != m_ids.end())
+			{
+				return it->second;
+			}
+
+			const auto id = m_size.load(std::memory_order_relaxed);
+			if (id >= Capacity || name.size() >= NameSize)
+			{
+				return invalid_id;
+			}
+			name.copy(m_names[id].data(), name.size());
+			m_names[id][name.size()] = '\0';
+			m_ids.emplace(std::string{ name }, static_cast<uint16_t>(id));
+			m_size.store(id + 1, std::memory_order_release);
+			return static_cast<uint16_t>(id);
+		}
+
+		uint16_t find(const std::string_view name) const
+		{
+			std::shared_lock lock{ m_mutex };
+			if (auto it = m_ids.find(name); it != m_ids.end())
+			{
+				return it->second;
+			}
+			return invalid_id;
+		}
+
+		// Null-terminated, so it can be passed straight to the server API.
+		const char* c_str(uint16_t id) const noexcept
+		{
+			return id < size() ? m_names[id].data() : "";
+		}
+
+		std::string_view name(uint16_t id) const noexcept
+		{
+			return c_str(id);
+		}
+
+		size_t size() const noexcept
+		{
+			return m_size.load(std::memory_order_acquire);
+		}
+
+	private:
+		mutable std::shared_mutex		m_mutex;
+		std::unordered_map<std::string, uint16_t, string_hash, std::equal_to<>> m_ids;
+		std::array<std::array<char, NameSize>, Capacity> m_names{};
+		std::atomic<size_t>				m_size{ 0 };
+	};
+
+	// Process-wide ids for symbols and groups, populated from the server configuration
+	// and extended by the configuration hooks.
+	struct registry
+	{
+		interner<max_symbols, 12>		symbols;	// ConSymbol::symbol
+		interner<max_groups, 16>		groups;		// ConGroup::group
+	};
+
+	template<size_t Size>
+	class atomic_bitset
+	{
+		static constexpr size_t word_bits = 64;
+
+	public:
+		static constexpr size_t size = Size;
+
+		bool test(size_t index) const noexcept
+		{
+			return (m_words[index / word_bits].load(std::memory_order_acquire) & mask(index)) != 0;
+		}
+
+		// Returns the previous value of the bit.
+		bool set(size_t index) noexcept
+		{
+			return (m_words[index / word_bits].fetch_or(mask(index), std::memory_order_acq_rel) & mask(index)) != 0;
+		}
+
+		bool reset(size_t index) noexcept
+		{
+			return (m_words[index / word_bits].fetch_and(~mask(index), std::memory_order_acq_rel) & mask(index)) != 0;
+		}
+
+	private:
+		static constexpr uint64_t mask(size_t index) noexcept
+		{
+			return uint64_t{ 1 } << (index % word_bits);
+		}
+
+		std::array<std::atomic<uint64_t>, (Size + word_bits - 1) / word_bits> m_words{};
+	};
+
+	// Plain bitset over dense ids. Word-wise AND and popcount let callers intersect sets
+	// and walk only the set bits instead of testing every id.
+	template<size_t Size>
+	class dense_bitset
+	{
+		static constexpr size_t word_bits = 64;
+
+	public:
+		static constexpr size_t size = Size;
+
+		bool test(size_t index) const noexcept
+		{
+			return index < Size && (m_words[index / word_bits] & mask(index)) != 0;
+		}
+
+		void set(size_t index, bool value = true) noexcept
+		{
+			if (value)
+			{
+				m_words[index / word_bits] |= mask(index);
+			}
+			else
+			{
+				m_words[index / word_bits] &= ~mask(index);
+			}
+		}
+
+		size_t count() const noexcept
+		{
+			size_t total{ 0 };
+			for (const auto word : m_words)
+			{
+				total += static_cast<size_t>(std::popcount(word));
+			}
+			return total;
+		}
+
+		dense_bitset& operator&= (const dense_bitset& other) noexcept
+		{
+			for (size_t i = 0; i < m_words.size(); ++i)
+			{
+				m_words[i] &= other.m_words[i];
+			}
+			return *this;
+		}
+
+		friend dense_bitset operator& (dense_bitset left, const dense_bitset& right) noexcept
+		{
+			return left &= right;
+		}
+
+		// Calls visit(index) for every set bit in ascending order until it returns false.
+		template<typename Visit>
+		bool for_each(Visit&& visit) const
+		{
+			for (size_t i = 0; i < m_words.size(); ++i)
+			{
+				for (auto word = m_words[i]; word != 0; word &= word - 1)
+				{
+					if (!visit(i * word_bits + static_cast<size_t>(std::countr_zero(word))))
+					{
+						return false;
+					}
+				}
+			}
+			return true;
+		}
+
+	private:
+		static constexpr uint64_t mask(size_t index) noexcept
+		{
+			return uint64_t{ 1 } << (index % word_bits);
+		}
+
+		std::array<uint64_t, (Size + word_bits - 1) / word_bits> m_words{};
+	};
+
+	using symbol_set = dense_bitset<max_symbols>;
+}
\ No newline at end of file
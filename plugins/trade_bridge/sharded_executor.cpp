@@ -0,0 +1,13 @@
+#include "sharded_executor.h"
+
+#include "mt4.h"
+
+namespace mt4
+{
+	void pin_current_thread(size_t cpu) noexcept
+	{
+		const auto cpus = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+		const auto index = std::min<size_t>(cpu % cpus, sizeof(DWORD_PTR) * 8 - 1);
+		SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR{ 1 } << index);
+	}
+}
\ No newline at end of file
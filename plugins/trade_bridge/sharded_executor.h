@@ -0,0 +1,243 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "mpsc_queue.h"
+
+namespace mt4
+{
+	// Binds the calling thread to one CPU, wraps around the number of CPUs.
+	void pin_current_thread(size_t cpu) noexcept;
+
+	// Runs tasks on a fixed set of workers, each draining its own queues. Tasks with the same
+	// key always land on the same worker and run in submission order within a priority level;
+	// different keys run in parallel. Workers can be pinned to consecutive CPUs to keep their
+	// caches warm.
+	//
+	// Level 0 is the most urgent. A worker takes the most urgent task it has, except that a
+	// level passed over max_bypass times in a row gets the next turn, so it can't starve.
+	template<typename Task, size_t Levels = 1>
+	class sharded_executor
+	{
+		static constexpr int spin_count = 256;
+
+		struct shard
+		{
+			explicit shard(size_t capacity)
+			{
+				for (auto& queue : queues)
+				{
+					queue = std::make_unique<mpsc_queue<Task>>(capacity);
+				}
+			}
+
+			std::array<std::unique_ptr<mpsc_queue<Task>>, Levels>	queues;
+			std::array<uint32_t, Levels>	bypassed{};		// worker only
+			std::atomic<uint32_t>	signal{ 0 };
+			std::atomic<bool>		waiting{ false };
+			std::thread				worker;
+		};
+
+	public:
+		using handler_t = std::function<void(Task&)>;
+
+		static constexpr size_t levels = Levels;
+
+		// Every level of every shard holds queue_capacity tasks; first_cpu < 0 leaves the workers unpinned.
+		// Dropped gets the tasks still queued at stop, so their submitters can be answered.
+		sharded_executor(size_t shards, size_t queue_capacity, int first_cpu, uint32_t max_bypass, handler_t handler, handler_t dropped)
+			: m_handler{ std::move(handler) }
+			, m_dropped{ std::move(dropped) }
+			, m_max_bypass{ std::max<uint32_t>(max_bypass, 1) }
+		{
+			shards = std::max<size_t>(shards, 1);
+			for (size_t i = 0; i < shards; ++i)
+			{
+				m_shards.push_back(std::make_unique<shard>(queue_capacity));
+			}
+			for (size_t i = 0; i < shards; ++i)
+			{
+				m_shards[i]->worker = std::thread{ [this, i, first_cpu]()
+				{
+					if (first_cpu >= 0)
+					{
+						pin_current_thread(static_cast<size_t>(first_cpu) + i);
+					}
+					run(*m_shards[i]);
+				} };
+			}
+		}
+
+		~sharded_executor()
+		{
+			stop();
+		}
+
+		sharded_executor(const sharded_executor&) = delete;
+		sharded_executor& operator= (const sharded_executor&) = delete;
+
+		// Returns false when the key's queue of that level is full, the task is not taken then.
+		bool submit(uint64_t key, size_t level, Task&& task)
+		{
+			auto& target = *m_shards[shard_of(key)];
+			if (!target.queues[std::min(level, Levels - 1)]->try_push(std::move(task)))
+			{
+				return false;
+			}
+			target.signal.fetch_add(1, std::memory_order_seq_cst);
+			if (target.waiting.load(std::memory_order_seq_cst))
+			{
+				target.signal.notify_one();
+			}
+			return true;
+		}
+
+		// Tasks still queued go to the dropped handler on the calling thread once the workers are
+		// gone, including the ones that handler submits.
+		void stop()
+		{
+			if (m_stopping.exchange(true))
+			{
+				return;
+			}
+			for (auto& target : m_shards)
+			{
+				target->signal.fetch_add(1);
+				target->signal.notify_one();
+			}
+			for (auto& target : m_shards)
+			{
+				if (target->worker.joinable())
+				{
+					target->worker.join();
+				}
+			}
+
+			Task task{};
+			for (bool dropped = true; dropped;)
+			{
+				dropped = false;
+				for (auto& target : m_shards)
+				{
+					for (size_t level = 0; level < Levels; ++level)
+					{
+						while (pop_level(*target, level, task))
+						{
+							m_dropped(task);
+							dropped = true;
+						}
+					}
+				}
+			}
+		}
+
+		size_t shards() const noexcept { return m_shards.size(); }
+
+		size_t queued(size_t index) const noexcept
+		{
+			size_t total{ 0 };
+			for (const auto& queue : m_shards[index]->queues)
+			{
+				total += queue->size();
+			}
+			return total;
+		}
+
+	private:
+		size_t shard_of(uint64_t key) const noexcept
+		{
+			// Fibonacci hashing spreads sequential logins evenly.
+			return static_cast<size_t>((key * 0x9E3779B97F4A7C15ull) >> 32) % m_shards.size();
+		}
+
+		bool try_pop(shard& own, Task& task)
+		{
+			for (size_t level = 1; level < Levels; ++level)
+			{
+				if (own.bypassed[level] >= m_max_bypass && pop_level(own, level, task))
+				{
+					return true;
+				}
+			}
+			for (size_t level = 0; level < Levels; ++level)
+			{
+				if (pop_level(own, level, task))
+				{
+					for (auto lower = level + 1; lower < Levels; ++lower)
+					{
+						own.bypassed[lower] += own.queues[lower]->empty() ? 0 : 1;
+					}
+					return true;
+				}
+			}
+			return false;
+		}
+
+		bool pop_level(shard& own, size_t level, Task& task)
+		{
+			auto& queue = *own.queues[level];
+			if (!queue.try_pop(task))
+			{
+				return false;
+			}
+			queue.publish_head();
+			own.bypassed[level] = 0;
+			return true;
+		}
+
+		void run(shard& own)
+		{
+			Task task{};
+			int idle{ 0 };
+			while (!m_stopping.load(std::memory_order_relaxed))
+			{
+				if (try_pop(own, task))
+				{
+					m_handler(task);
+					idle = 0;
+					continue;
+				}
+				if (++idle < spin_count)
+				{
+					std::this_thread::yield();
+					continue;
+				}
+
+				// Producers notify only while waiting is set; the second pop closes the race
+				// with a push that happened before the flag became visible. Stop signals once,
+				// so it is checked again after seen: a stop that signalled before seen was read
+				// is visible here, one that comes later changes the signal and wakes the wait.
+				const auto seen = own.signal.load(std::memory_order_seq_cst);
+				own.waiting.store(true, std::memory_order_seq_cst);
+				if (m_stopping.load(std::memory_order_seq_cst))
+				{
+					own.waiting.store(false, std::memory_order_relaxed);
+					break;
+				}
+				if (try_pop(own, task))
+				{
+					own.waiting.store(false, std::memory_order_relaxed);
+					m_handler(task);
+					idle = 0;
+					continue;
+				}
+				own.signal.wait(seen, std::memory_order_seq_cst);
+				own.waiting.store(false, std::memory_order_relaxed);
+				idle = 0;
+			}
+		}
+
+		handler_t							m_handler;
+		handler_t							m_dropped;
+		const uint32_t						m_max_bypass;
+		std::vector<std::unique_ptr<shard>>	m_shards;
+		std::atomic<bool>					m_stopping{ false };
+	};
+}
\ No newline at end of file
@@ -0,0 +1,221 @@
+#include "shm_catalog.h"
+
+#include <cstring>
+
+#include <fmt/core.h>
+
+#include "mt4.h"
+#include "../catalog/catalog.h"
+
+namespace
+{
+	static_assert(catalog::max_symbols == mt4::max_symbols);
+	static_assert(catalog::max_groups == mt4::max_groups);
+	static_assert(catalog::max_sec_groups == MAX_SEC_GROUPS);
+	static_assert(catalog::max_margins == MAX_SEC_GROPS_MARGIN);
+
+	template<size_t Size, size_t SourceSize>
+	void copy_name(char (&target)[Size], const char (&source)[SourceSize])
+	{
+		static_assert(Size >= SourceSize);
+		std::memcpy(target, source, SourceSize);
+		target[SourceSize - 1] = '\0';
+	}
+
+	void fill(catalog::symbol_record& record, const ConSymbol& symbol)
+	{
+		record.present = 1;
+		copy_name(record.name, symbol.symbol);
+		copy_name(record.description, symbol.description);
+		copy_name(record.currency, symbol.currency);
+		copy_name(record.margin_currency, symbol.margin_currency);
+		record.type = symbol.type;
+		record.digits = symbol.digits;
+		record.trade = symbol.trade;
+		record.long_only = symbol.long_only;
+		record.exemode = symbol.exemode;
+		record.stops_level = symbol.stops_level;
+		record.freeze_level = symbol.freeze_level;
+		record.profit_mode = symbol.profit_mode;
+		record.margin_mode = symbol.margin_mode;
+		record.contract_size = symbol.contract_size;
+		record.tick_size = symbol.tick_size;
+		record.tick_value = symbol.tick_value;
+		record.point = symbol.point;
+		record.swap_long = symbol.swap_long;
+		record.swap_short = symbol.swap_short;
+		record.margin_initial = symbol.margin_initial;
+		record.margin_divider = symbol.margin_divider;
+	}
+
+	void fill(catalog::group_record& record, const ConGroup& group, const mt4::registry& ids)
+	{
+		record.present = 1;
+		copy_name(record.name, group.group);
+		copy_name(record.currency, group.currency);
+		record.enable = group.enable;
+		record.default_leverage = group.default_leverage;
+		record.margin_call = group.margin_call;
+		record.margin_stopout = group.margin_stopout;
+		record.margin_mode = group.margin_mode;
+
+		for (size_t i = 0; i < catalog::max_sec_groups; ++i)
+		{
+			const auto& sec = group.secgroups[i];
+			record.sec[i] = catalog::group_sec_record{
+				.show = sec.show,
+				.trade = sec.trade,
+				.execution = sec.execution,
+				.lot_min = sec.lot_min,
+				.lot_max = sec.lot_max,
+				.lot_step = sec.lot_step
+			};
+		}
+
+		record.margins_total = 0;
+		for (int i = 0; i < group.secmargins_total && i < MAX_SEC_GROPS_MARGIN; ++i)
+		{
+			const auto& margin = group.secmargins[i];
+			record.margins[record.margins_total++] = catalog::margin_record{
+				.symbol = ids.symbols.find(margin.symbol),
+				.swap_long = margin.swap_long,
+				.swap_short = margin.swap_short,
+				.margin_divider = margin.margin_divider
+			};
+		}
+	}
+}
+
+namespace mt4
+{
+	shm_catalog::shm_catalog() noexcept
+		: m_mapping{ nullptr }
+		, m_region{ nullptr }
+	{
+	}
+
+	shm_catalog::~shm_catalog()
+	{
+		if (m_region != nullptr)
+		{
+			UnmapViewOfFile(m_region);
+		}
+		if (m_mapping != nullptr)
+		{
+			CloseHandle(m_mapping);
+		}
+	}
+
+	tl::expected<void, std::string> shm_catalog::open(const std::string_view name)
+	{
+		constexpr uint64_t size = sizeof(catalog::region);
+
+		const auto mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+			static_cast<DWORD>(size >> 32), static_cast<DWORD>(size & 0xFFFFFFFF), std::string{ name }.c_str());
+		if (mapping == nullptr)
+		{
+			return tl::unexpected{ fmt::format("CreateFileMapping failed, error: {}", GetLastError()) };
+		}
+		const auto region = static_cast<catalog::region*>(MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, size));
+		if (region == nullptr)
+		{
+			CloseHandle(mapping);
+			return tl::unexpected{ fmt::format("MapViewOfFile failed, error: {}", GetLastError()) };
+		}
+
+		std::lock_guard lock{ m_mutex };
+		m_mapping = mapping;
+		m_region = region;
+
+		// A mapping left over from a previous plugin instance keeps its sequence, so readers
+		// that are already attached see the reload as one more update. A writer that died inside
+		// a write left it odd; made even, the next write starts odd again as readers expect. The
+		// torn records stay until the full publish that follows open.
+		auto& sequence = m_region->head.sequence;
+		if (const auto current = sequence.load(std::memory_order_relaxed); current % 2 != 0)
+		{
+			sequence.store(current + 1, std::memory_order_release);
+		}
+		m_region->head.magic = catalog::magic;
+		m_region->head.layout_version = catalog::layout_version;
+		return {};
+	}
+
+	void shm_catalog::publish(const config_view& view, const registry& ids)
+	{
+		write(view, [&](catalog::region& region)
+		{
+			std::memset(region.symbols, 0, sizeof(region.symbols));
+			std::memset(region.groups, 0, sizeof(region.groups));
+
+			for (symbol_id id = 0; id < view.symbols().size(); ++id)
+			{
+				if (const auto symbol = view.symbol(id); symbol != nullptr)
+				{
+					fill(region.symbols[id], *symbol);
+				}
+			}
+			for (group_id id = 0; id < view.groups().size(); ++id)
+			{
+				if (const auto group = view.group(id); group != nullptr)
+				{
+					fill(region.groups[id], *group, ids);
+				}
+			}
+		});
+	}
+
+	void shm_catalog::update(const config_view& view, symbol_id id, const ConSymbol& symbol)
+	{
+		write(view, [&](catalog::region& region)
+		{
+			fill(region.symbols[id], symbol);
+		});
+	}
+
+	void shm_catalog::update(const config_view& view, const registry& ids, group_id id, const ConGroup& group)
+	{
+		write(view, [&](catalog::region& region)
+		{
+			fill(region.groups[id], group, ids);
+		});
+	}
+
+	void shm_catalog::erase_symbol(const config_view& view, symbol_id id)
+	{
+		write(view, [&](catalog::region& region)
+		{
+			std::memset(&region.symbols[id], 0, sizeof(region.symbols[id]));
+		});
+	}
+
+	void shm_catalog::erase_group(const config_view& view, group_id id)
+	{
+		write(view, [&](catalog::region& region)
+		{
+			std::memset(&region.groups[id], 0, sizeof(region.groups[id]));
+		});
+	}
+
+	template<typename Writer>
+	void shm_catalog::write(const config_view& view, Writer&& writer)
+	{
+		std::lock_guard lock{ m_mutex };
+		if (m_region == nullptr)
+		{
+			return;
+		}
+
+		auto& sequence = m_region->head.sequence;
+		const auto current = sequence.load(std::memory_order_relaxed);
+		sequence.store(current + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+
+		writer(*m_region);
+		m_region->head.config_version = view.version();
+		m_region->head.symbols_total = static_cast<uint32_t>(view.symbols().size());
+		m_region->head.groups_total = static_cast<uint32_t>(view.groups().size());
+
+		sequence.store(current + 2, std::memory_order_release);
+	}
+}
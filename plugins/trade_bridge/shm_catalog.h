@@ -0,0 +1,48 @@
+#pragma once
+
+#include <mutex>
+#include <string>
+
+#include <tl/expected.hpp>
+
+#include "registry.h"
+#include "config_store.h"
+
+struct ConGroup;
+struct ConSymbol;
+
+namespace catalog
+{
+	struct region;
+}
+
+namespace mt4
+{
+	// Writer side of the shared-memory catalog (see plugins/catalog/catalog.h for the reader).
+	// Co-located services get the interned symbols and groups without subscribing to NATS.
+	class shm_catalog
+	{
+	public:
+		shm_catalog() noexcept;
+		~shm_catalog();
+
+		shm_catalog(const shm_catalog&) = delete;
+		shm_catalog& operator= (const shm_catalog&) = delete;
+
+		tl::expected<void, std::string> open(const std::string_view name);
+
+		void publish(const config_view& view, const registry& ids);
+		void update(const config_view& view, symbol_id id, const ConSymbol& symbol);
+		void update(const config_view& view, const registry& ids, group_id id, const ConGroup& group);
+		void erase_symbol(const config_view& view, symbol_id id);
+		void erase_group(const config_view& view, group_id id);
+
+	private:
+		template<typename Writer>
+		void write(const config_view& view, Writer&& writer);
+
+		std::mutex			m_mutex;
+		void*				m_mapping;
+		catalog::region*	m_region;
+	};
+}
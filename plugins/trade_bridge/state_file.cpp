@@ -0,0 +1,146 @@
+#include "state_file.h"
+
+#include <cstddef>
+#include <cstring>
+
+#include <fmt/core.h>
+
+#include "tools.h"
+
+#include "mt4.h"
+
+namespace mt4
+{
+	state_file::state_file() noexcept
+		: m_file{ INVALID_HANDLE_VALUE }
+		, m_mapping{ nullptr }
+		, m_records{ nullptr }
+		, m_staging{ nullptr }
+		, m_sequence{ 0 }
+		, m_torn{ 0 }
+		, m_previous{ nullptr }
+	{
+	}
+
+	state_file::~state_file()
+	{
+		if (m_records != nullptr)
+		{
+			FlushViewOfFile(m_records, 0);
+			UnmapViewOfFile(m_records);
+		}
+		if (m_mapping != nullptr)
+		{
+			CloseHandle(m_mapping);
+		}
+		if (m_file != INVALID_HANDLE_VALUE)
+		{
+			CloseHandle(m_file);
+		}
+	}
+
+	tl::expected<void, std::string> state_file::open(const std::filesystem::path& path)
+	{
+		constexpr uint64_t size = 2 * sizeof(layout);
+
+		std::lock_guard lock{ m_mutex };
+
+		const auto file = CreateFileA(path.string().c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr,
+			OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+		{
+			return tl::unexpected{ fmt::format("CreateFile failed, error: {}", GetLastError()) };
+		}
+
+		LARGE_INTEGER existing_size{};
+		GetFileSizeEx(file, &existing_size);
+
+		// The mapping grows the file to the layout size if needed, new bytes are zero.
+		const auto mapping = CreateFileMappingA(file, nullptr, PAGE_READWRITE,
+			static_cast<DWORD>(size >> 32), static_cast<DWORD>(size & 0xFFFFFFFF), nullptr);
+		if (mapping == nullptr)
+		{
+			CloseHandle(file);
+			return tl::unexpected{ fmt::format("CreateFileMapping failed, error: {}", GetLastError()) };
+		}
+		const auto mapped = static_cast<layout*>(MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, size));
+		if (mapped == nullptr)
+		{
+			CloseHandle(mapping);
+			CloseHandle(file);
+			return tl::unexpected{ fmt::format("MapViewOfFile failed, error: {}", GetLastError()) };
+		}
+
+		m_file = file;
+		m_mapping = mapping;
+		m_records = mapped;
+		m_staging = std::make_unique<layout>();
+
+		// The newest record that is whole wins, a torn one is as good as none.
+		const layout* latest{ nullptr };
+		if (static_cast<uint64_t>(existing_size.QuadPart) >= size)
+		{
+			for (size_t i = 0; i < 2; ++i)
+			{
+				const auto& record = m_records[i];
+				if (record.magic != magic || record.layout_version != layout_version)
+				{
+					continue;
+				}
+				if (!is_valid(record))
+				{
+					++m_torn;
+					continue;
+				}
+				if (latest == nullptr || record.sequence > latest->sequence)
+				{
+					latest = &record;
+				}
+			}
+		}
+
+		if (latest != nullptr)
+		{
+			m_previous = std::make_unique<layout>();
+			std::memcpy(m_previous.get(), latest, sizeof(layout));
+			std::memcpy(m_staging.get(), latest, sizeof(layout));
+			m_sequence = latest->sequence;
+		}
+		else
+		{
+			std::memset(m_records, 0, size);
+			std::memset(m_staging.get(), 0, sizeof(layout));
+		}
+		return {};
+	}
+
+	uint64_t state_file::checksum(const layout& record) noexcept
+	{
+		constexpr auto sealed = offsetof(layout, checksum) + sizeof(layout::checksum);
+		return tools::hash_bytes(reinterpret_cast<const char*>(&record) + sealed, sizeof(layout) - sealed,
+			tools::hash_bytes(&record.sequence, sizeof(record.sequence)));
+	}
+
+	bool state_file::is_valid(const layout& record) noexcept
+	{
+		return record.sequence != 0 && record.checksum == checksum(record);
+	}
+
+	tl::expected<void, std::string> state_file::commit()
+	{
+		m_staging->magic = magic;
+		m_staging->layout_version = layout_version;
+		m_staging->sequence = m_sequence + 1;
+		m_staging->checksum = checksum(*m_staging);
+
+		// The record of the last complete save stays untouched until this one is on disk.
+		auto& target = m_records[m_staging->sequence % 2];
+		std::memcpy(&target, m_staging.get(), sizeof(layout));
+		if (!FlushViewOfFile(&target, sizeof(layout)) || !FlushFileBuffers(m_file))
+		{
+			return tl::unexpected{ fmt::format("Failed to flush state file, error: {}", GetLastError()) };
+		}
+		m_sequence = m_staging->sequence;
+		return {};
+	}
+}
\ No newline at end of file
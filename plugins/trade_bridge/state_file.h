@@ -0,0 +1,102 @@
+#pragma once
+
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include <tl/expected.hpp>
+
+#include "registry.h"
+
+namespace mt4
+{
+	// Memory-mapped record of what the plugin has published: content hashes of every symbol
+	// and group, chart checkpoints and the configuration version. On startup the previous
+	// record tells which parts of the configuration changed while the plugin was down.
+	//
+	// The file holds two records and saves alternate between them, each sealed with a sequence
+	// number and a checksum. A save cut short by a crash leaves a record that fails its checksum,
+	// the other one still holds the last complete save.
+	class state_file
+	{
+	public:
+		static constexpr uint32_t magic = 0x5334544D; // "MT4S"
+		static constexpr uint32_t layout_version = 2;
+		static constexpr size_t chart_periods_total = 9;
+
+		struct symbol_entry
+		{
+			char		name[12];			// empty for unused slots
+			uint32_t	reserved;
+			uint64_t	hash;
+			int64_t		chart_checkpoints[chart_periods_total];
+		};
+
+		struct group_entry
+		{
+			char		name[16];			// empty for unused slots
+			uint64_t	hash;				// zero while a publication was still pending
+		};
+
+		struct layout
+		{
+			uint32_t		magic;
+			uint32_t		layout_version;
+			uint64_t		sequence;
+			uint64_t		checksum;			// of everything after this field
+			uint64_t		config_version;
+			int64_t			saved_at;
+			uint32_t		symbols_total;
+			uint32_t		groups_total;
+			symbol_entry	symbols[max_symbols];
+			group_entry		groups[max_groups];
+		};
+
+		state_file() noexcept;
+		~state_file();
+
+		state_file(const state_file&) = delete;
+		state_file& operator= (const state_file&) = delete;
+
+		tl::expected<void, std::string> open(const std::filesystem::path& path);
+
+		// Set by open before any save can run.
+		bool is_open() const noexcept { return m_records != nullptr; }
+
+		// State saved by the previous plugin instance, null on the first run, after a layout
+		// change or when no record passed its checksum.
+		const layout* previous() const noexcept { return m_previous.get(); }
+		// Records that carried the magic but failed the checksum on open.
+		size_t torn() const noexcept { return m_torn; }
+
+		// Fill runs on a staging copy under the file lock. The sealed copy then goes to the record
+		// not holding the last save, and is flushed to disk.
+		template<typename Fill>
+		tl::expected<void, std::string> save(Fill&& fill)
+		{
+			std::lock_guard lock{ m_mutex };
+			if (m_records == nullptr)
+			{
+				return tl::unexpected{ std::string{ "state file is not open" } };
+			}
+			fill(*m_staging);
+			return commit();
+		}
+
+	private:
+		static uint64_t checksum(const layout& record) noexcept;
+		static bool is_valid(const layout& record) noexcept;
+
+		tl::expected<void, std::string> commit();
+
+		std::mutex					m_mutex;
+		void*						m_file;
+		void*						m_mapping;
+		layout*						m_records;		// two of them
+		std::unique_ptr<layout>		m_staging;
+		uint64_t					m_sequence;		// of the last complete record
+		size_t						m_torn;
+		std::unique_ptr<layout>		m_previous;
+	};
+}
\ No newline at end of file
@@ -0,0 +1,140 @@
+#include "symbols_snapshot.h"
+
+#include <string_view>
+#include <unordered_map>
+
+#include <zlib.h>
+
+#include "json.h"
+#include "models.h"
+
+namespace
+{
+	class dictionary
+	{
+	public:
+		// Keys point into the rows, which outlive the dictionary.
+		uint32_t index_of(const std::string_view value)
+		{
+			auto [it, inserted] = m_indexes.try_emplace(value, static_cast<uint32_t>(m_values.size()));
+			if (inserted)
+			{
+				m_values.emplace_back(value);
+			}
+			return it->second;
+		}
+
+		const std::vector<std::string>& values() const { return m_values; }
+		size_t size() const { return m_values.size(); }
+
+	private:
+		std::unordered_map<std::string_view, uint32_t>	m_indexes;
+		std::vector<std::string>					m_values;
+	};
+}
+
+namespace mt4
+{
+	symbols_snapshot::symbols_snapshot() noexcept
+		: m_blob_version{ 0 }
+		, m_blob{ nullptr }
+	{
+	}
+
+	tl::expected<symbols_snapshot::blob_t, std::string> symbols_snapshot::get(uint64_t version, const collect_t& collect)
+	{
+		std::lock_guard lock{ m_mutex };
+
+		if (m_blob && m_blob_version == version)
+		{
+			return m_blob;
+		}
+
+		auto encoded = encode(version, collect());
+		if (!encoded)
+		{
+			return tl::unexpected{ encoded.error() };
+		}
+		m_blob = std::make_shared<const std::string>(std::move(*encoded));
+		m_blob_version = version;
+		return m_blob;
+	}
+
+	tl::expected<std::string, std::string> symbols_snapshot::encode(uint64_t version, const std::vector<group_symbol>& rows)
+	{
+		// Symbol attributes are the same for every group, so they are stored once per symbol
+		// and rows only reference them by index.
+		dictionary groups{};
+		dictionary symbols{};
+		json::type symbol_description = json::type::array();
+		json::type symbol_digits = json::type::array();
+		json::type symbol_contract_size = json::type::array();
+		json::type symbol_tick_size = json::type::array();
+
+		std::vector<uint32_t> row_group{};
+		std::vector<uint32_t> row_symbol{};
+		std::vector<int> row_mode{};
+		std::vector<double> row_swap_long{};
+		std::vector<double> row_swap_short{};
+		std::vector<int> row_lot_min{};
+		std::vector<int> row_lot_max{};
+		std::vector<int> row_lot_step{};
+
+		for (const auto& row : rows)
+		{
+			const auto symbols_count = symbols.size();
+			const auto symbol_index = symbols.index_of(row.symbol);
+			if (symbols.size() != symbols_count)
+			{
+				symbol_description.push_back(row.description);
+				symbol_digits.push_back(row.digits);
+				symbol_contract_size.push_back(row.contract_size);
+				symbol_tick_size.push_back(row.tick_size);
+			}
+
+			row_group.push_back(groups.index_of(row.account_group));
+			row_symbol.push_back(symbol_index);
+			row_mode.push_back(static_cast<int>(row.mode));
+			row_swap_long.push_back(row.swap_long);
+			row_swap_short.push_back(row.swap_short);
+			row_lot_min.push_back(row.lot_min);
+			row_lot_max.push_back(row.lot_max);
+			row_lot_step.push_back(row.lot_step);
+		}
+
+		const json::type document
+		{
+			{ "version",	version },
+			{ "groups",		groups.values() },
+			{ "symbols",	{
+				{ "symbol",			symbols.values() },
+				{ "description",	symbol_description },
+				{ "digits",			symbol_digits },
+				{ "contract_size",	symbol_contract_size },
+				{ "tick_size",		symbol_tick_size },
+			} },
+			{ "rows",		{
+				{ "group",			row_group },
+				{ "symbol",			row_symbol },
+				{ "trade",			row_mode },
+				{ "swap_long",		row_swap_long },
+				{ "swap_short",		row_swap_short },
+				{ "lot_min",		row_lot_min },
+				{ "lot_max",		row_lot_max },
+				{ "lot_step",		row_lot_step },
+			} },
+		};
+
+		const auto packed = json::type::to_msgpack(document);
+
+		uLongf compressed_size = compressBound(static_cast<uLong>(packed.size()));
+		std::string compressed(compressed_size, '\0');
+		if (auto status = compress2(reinterpret_cast<Bytef*>(compressed.data()), &compressed_size,
+			packed.data(), static_cast<uLong>(packed.size()), Z_BEST_SPEED); status != Z_OK)
+		{
+			return tl::unexpected{ std::string{ "Failed to compress symbols snapshot: " } + zError(status) };
+		}
+		compressed.resize(compressed_size);
+		return compressed;
+	}
+}
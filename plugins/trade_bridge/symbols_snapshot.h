@@ -0,0 +1,37 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <functional>
+
+#include <tl/expected.hpp>
+
+namespace mt4
+{
+	struct group_symbol;
+
+	// Full group x symbol matrix encoded as a single blob, so restarting consumers
+	// don't have to rebuild it from individual mt4_symbol messages.
+	// The blob is tagged with the configuration version; group_symbol updates published
+	// afterwards carry newer versions, so a consumer applies only those newer than its snapshot.
+	class symbols_snapshot
+	{
+	public:
+		using blob_t = std::shared_ptr<const std::string>;
+		using collect_t = std::function<std::vector<group_symbol>()>;
+
+		symbols_snapshot() noexcept;
+
+		// Returns cached bytes while the configuration version is unchanged, otherwise rebuilds them from collect().
+		tl::expected<blob_t, std::string> get(uint64_t version, const collect_t& collect);
+
+		static tl::expected<std::string, std::string> encode(uint64_t version, const std::vector<group_symbol>& rows);
+
+	private:
+		std::mutex				m_mutex;
+		uint64_t				m_blob_version;
+		blob_t					m_blob;
+	};
+}
@@ -0,0 +1,236 @@
+#include "timer_wheel.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace mt4
+{
+	timer_wheel::timer_wheel(std::chrono::milliseconds resolution, size_t capacity)
+		: m_resolution{ std::max<clock_t::duration>(resolution, std::chrono::milliseconds{ 1 }) }
+		, m_started{ clock_t::now() }
+		, m_nodes(std::max<size_t>(capacity, 1))
+	{
+		for (auto& level : m_slots)
+		{
+			level.fill(nil);
+		}
+		// Free nodes are chained through next.
+		for (size_t i = 0; i < m_nodes.size(); ++i)
+		{
+			m_nodes[i].next = i + 1 < m_nodes.size() ? static_cast<uint32_t>(i + 1) : nil;
+		}
+		m_free = 0;
+	}
+
+	timer_wheel::~timer_wheel()
+	{
+		stop();
+	}
+
+	void timer_wheel::start()
+	{
+		if (!m_thread.joinable())
+		{
+			m_thread = std::thread{ [this]() { run(); } };
+		}
+	}
+
+	void timer_wheel::stop()
+	{
+		m_stopping.store(true, std::memory_order_relaxed);
+		if (m_thread.joinable())
+		{
+			m_thread.join();
+		}
+	}
+
+	timer_wheel::handle timer_wheel::arm(clock_t::duration delay, callback_t callback)
+	{
+		return schedule(to_ticks(delay), 0, std::move(callback));
+	}
+
+	timer_wheel::handle timer_wheel::every(clock_t::duration period, callback_t callback)
+	{
+		const auto ticks = to_ticks(period);
+		return schedule(ticks, ticks, std::move(callback));
+	}
+
+	bool timer_wheel::cancel(handle timer)
+	{
+		if (!timer.valid() || timer.index >= m_nodes.size())
+		{
+			return false;
+		}
+		std::lock_guard lock{ m_mutex };
+		auto& entry = m_nodes[timer.index];
+		if (!entry.armed || entry.generation != timer.generation)
+		{
+			return false;
+		}
+		unlink(timer.index);
+		release(timer.index);
+		return true;
+	}
+
+	timer_wheel::handle timer_wheel::schedule(uint64_t delay_ticks, uint64_t period_ticks, callback_t&& callback)
+	{
+		std::lock_guard lock{ m_mutex };
+		if (m_free == nil)
+		{
+			return handle{};
+		}
+		const auto index = m_free;
+		auto& entry = m_nodes[index];
+		m_free = entry.next;
+
+		// Zero would land in the slot being expired and wait a whole turn.
+		entry.expires = m_now + std::max<uint64_t>(delay_ticks, 1);
+		entry.period = period_ticks;
+		entry.callback = std::move(callback);
+		entry.armed = true;
+		link(index);
+		return handle{ index, entry.generation };
+	}
+
+	// Rounded up, a timer never fires early.
+	uint64_t timer_wheel::to_ticks(clock_t::duration delay) const noexcept
+	{
+		const auto ticks = (std::max<clock_t::duration>(delay, clock_t::duration::zero()) + m_resolution - clock_t::duration{ 1 }) / m_resolution;
+		return static_cast<uint64_t>(ticks);
+	}
+
+	void timer_wheel::link(uint32_t index)
+	{
+		auto& entry = m_nodes[index];
+		constexpr uint64_t horizon = uint64_t{ 1 } << (slot_bits * levels_total);
+		// Beyond the top level the timer parks in the farthest slot and is re-linked when it cascades.
+		const auto delta = std::min(entry.expires - std::min(entry.expires, m_now), horizon - 1);
+		const auto target = m_now + delta;
+
+		size_t level{ 0 };
+		while (level + 1 < levels_total && delta >= (uint64_t{ 1 } << (slot_bits * (level + 1))))
+		{
+			++level;
+		}
+		const auto slot = static_cast<size_t>((target >> (slot_bits * level)) & (slots_total - 1));
+
+		auto& head = m_slots[level][slot];
+		entry.level = static_cast<uint16_t>(level);
+		entry.slot = static_cast<uint16_t>(slot);
+		entry.prev = nil;
+		entry.next = head;
+		if (head != nil)
+		{
+			m_nodes[head].prev = index;
+		}
+		head = index;
+	}
+
+	void timer_wheel::unlink(uint32_t index)
+	{
+		auto& entry = m_nodes[index];
+		if (entry.prev != nil)
+		{
+			m_nodes[entry.prev].next = entry.next;
+		}
+		else
+		{
+			m_slots[entry.level][entry.slot] = entry.next;
+		}
+		if (entry.next != nil)
+		{
+			m_nodes[entry.next].prev = entry.prev;
+		}
+	}
+
+	void timer_wheel::release(uint32_t index)
+	{
+		auto& entry = m_nodes[index];
+		entry.armed = false;
+		entry.callback = nullptr;
+		++entry.generation;
+		entry.next = m_free;
+		m_free = index;
+	}
+
+	void timer_wheel::advance(std::vector<callback_t>& due)
+	{
+		++m_now;
+
+		// Each time a level wraps, the next coarser slot is spread over the finer levels.
+		if ((m_now & (slots_total - 1)) == 0)
+		{
+			for (size_t level = 1; level < levels_total; ++level)
+			{
+				const auto slot = static_cast<size_t>((m_now >> (slot_bits * level)) & (slots_total - 1));
+				auto index = std::exchange(m_slots[level][slot], nil);
+				while (index != nil)
+				{
+					const auto next = m_nodes[index].next;
+					link(index);
+					index = next;
+				}
+				if (slot != 0)
+				{
+					break;
+				}
+			}
+		}
+
+		auto index = std::exchange(m_slots[0][m_now & (slots_total - 1)], nil);
+		while (index != nil)
+		{
+			auto& entry = m_nodes[index];
+			const auto next = entry.next;
+			if (entry.expires > m_now)
+			{
+				link(index);
+			}
+			else if (entry.period != 0)
+			{
+				due.push_back(entry.callback);
+				entry.expires = m_now + entry.period;
+				link(index);
+			}
+			else
+			{
+				due.push_back(std::move(entry.callback));
+				release(index);
+			}
+			index = next;
+		}
+	}
+
+	void timer_wheel::run()
+	{
+		std::vector<callback_t> due{};
+		uint64_t ticks{ 0 };
+		while (!m_stopping.load(std::memory_order_relaxed))
+		{
+			std::this_thread::sleep_until(m_started + (ticks + 1) * m_resolution);
+			const auto target = static_cast<uint64_t>((clock_t::now() - m_started) / m_resolution);
+			{
+				std::lock_guard lock{ m_mutex };
+				while (m_now < target)
+				{
+					advance(due);
+				}
+				ticks = m_now;
+			}
+			if (due.empty())
+			{
+				continue;
+			}
+			const auto dispatched = clock_t::now();
+			for (auto& callback : due)
+			{
+				callback();
+			}
+			due.clear();
+			if (const auto spent = static_cast<uint64_t>((clock_t::now() - dispatched) / m_resolution); spent != 0)
+			{
+				m_late.fetch_add(spent, std::memory_order_relaxed);
+			}
+		}
+	}
+}
\ No newline at end of file
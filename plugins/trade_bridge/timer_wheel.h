@@ -0,0 +1,102 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace mt4
+{
+	// Hashed hierarchical timer wheel: four levels of 64 slots, each level 64 times coarser than
+	// the one below. Arm and cancel are O(1), and a tick touches one slot plus, every 64 ticks,
+	// the cascade of one coarser slot. One thread drives every deadline and periodic duty of the
+	// plugin, so no task has to sleep or poll on its own.
+	//
+	// Callbacks run on the wheel thread and must stay short, heavy work goes to a pool.
+	class timer_wheel
+	{
+		static constexpr size_t slot_bits = 6;
+		static constexpr size_t slots_total = size_t{ 1 } << slot_bits;
+		static constexpr size_t levels_total = 4;
+		static constexpr uint32_t nil = UINT32_MAX;
+
+		struct node
+		{
+			uint64_t					expires;		// in ticks
+			uint64_t					period;			// in ticks, 0 for one-shot timers
+			std::function<void()>		callback;
+			uint32_t					generation;
+			uint32_t					prev;
+			uint32_t					next;
+			uint16_t					level;
+			uint16_t					slot;
+			bool						armed;
+		};
+
+	public:
+		using clock_t = std::chrono::steady_clock;
+		using callback_t = std::function<void()>;
+
+		struct handle
+		{
+			uint32_t	index{ nil };
+			uint32_t	generation{ 0 };
+
+			bool valid() const noexcept { return index != nil; }
+		};
+
+		timer_wheel(std::chrono::milliseconds resolution, size_t capacity);
+		~timer_wheel();
+
+		timer_wheel(const timer_wheel&) = delete;
+		timer_wheel& operator= (const timer_wheel&) = delete;
+
+		void start();
+		void stop();
+
+		// Returns an invalid handle when all timers are in use.
+		handle arm(clock_t::duration delay, callback_t callback);
+
+		// Runs every period until cancelled, the first time one period from now.
+		handle every(clock_t::duration period, callback_t callback);
+
+		// False when the timer already fired or was cancelled. A periodic timer cancelled while
+		// its callback is being dispatched runs that one last time.
+		bool cancel(handle timer);
+
+		size_t capacity() const noexcept { return m_nodes.size(); }
+
+		// Ticks the wheel thread spent in callbacks, a sign of callbacks blocking it. Oversleeping
+		// doesn't count: Windows wakes sleepers at its own timer granularity, ~15.6 ms by default.
+		uint64_t late() noexcept { return m_late.exchange(0, std::memory_order_relaxed); }
+
+	private:
+		handle schedule(uint64_t delay_ticks, uint64_t period_ticks, callback_t&& callback);
+		uint64_t to_ticks(clock_t::duration delay) const noexcept;
+
+		void link(uint32_t index);
+		void unlink(uint32_t index);
+		void release(uint32_t index);
+
+		void run();
+		// Advances one tick and moves the due callbacks out, called under the lock.
+		void advance(std::vector<callback_t>& due);
+
+		const clock_t::duration		m_resolution;
+		const clock_t::time_point	m_started;
+
+		std::mutex					m_mutex;
+		std::vector<node>			m_nodes;
+		uint32_t					m_free{ nil };
+		std::array<std::array<uint32_t, slots_total>, levels_total> m_slots;
+		uint64_t					m_now{ 0 };		// ticks since m_started
+
+		std::atomic<bool>			m_stopping{ false };
+		std::atomic<uint64_t>		m_late{ 0 };
+		std::thread					m_thread;
+	};
+}
\ No newline at end of file
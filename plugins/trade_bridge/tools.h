@@ -1,5 +1,8 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
+
 static const double const_digits[] = { 1.0, 10.0, 100.0, 1000.0, 10000.0, 100000.0 };
 
 namespace tools
@@ -8,4 +11,15 @@ namespace tools
     {
         return price / const_digits[digits];
     }
+
+    // FNV-1a, chained through seed to hash several fields.
+    inline uint64_t hash_bytes(const void* data, size_t size, uint64_t seed = 14695981039346656037ull)
+    {
+        auto bytes = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < size; ++i)
+        {
+            seed = (seed ^ bytes[i]) * 1099511628211ull;
+        }
+        return seed;
+    }
 }
\ No newline at end of file
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "models.h"
+
+namespace mt4
+{
+	// Gathers the outcomes of a basket's legs while they execute on the trade workers. Each leg
+	// writes only its own slot, and the leg that completes the basket publishes the response, so
+	// the basket takes about as long as its slowest leg.
+	class pending_basket
+	{
+	public:
+		using ptr_t = std::shared_ptr<pending_basket>;
+
+		pending_basket(int basket_id, std::string_view reply_to, size_t legs, std::chrono::steady_clock::time_point received)
+			: m_reply_to{ reply_to }
+			, m_received{ received }
+			, m_response{ .basket_id = basket_id, .reject_code = 0, .legs = std::vector<trade_response>(legs) }
+			, m_remaining{ legs }
+		{
+		}
+
+		pending_basket(const pending_basket&) = delete;
+		pending_basket& operator= (const pending_basket&) = delete;
+
+		// True for the call that completes the basket, its response is final from then on.
+		bool complete(size_t leg, trade_response&& response) noexcept
+		{
+			m_response.legs[leg] = std::move(response);
+			return m_remaining.fetch_sub(1, std::memory_order_acq_rel) == 1;
+		}
+
+		const std::string& reply_to() const noexcept { return m_reply_to; }
+		std::chrono::steady_clock::time_point received() const noexcept { return m_received; }
+		const trade_basket_response& response() const noexcept { return m_response; }
+
+	private:
+		const std::string						m_reply_to;
+		const std::chrono::steady_clock::time_point m_received;
+		trade_basket_response					m_response;
+		std::atomic<size_t>						m_remaining;
+	};
+}
\ No newline at end of file
@@ -0,0 +1,117 @@
+#include "trade_events.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <ctime>
+
+#include "mt4.h"
+
+namespace mt4
+{
+	trade_event make_trade_event(const TradeRecord& trade, trade_event::event_kind kind) noexcept
+	{
+		trade_event event{
+			.sequence = 0,
+			.kind = kind,
+			.order = trade.order,
+			.login = trade.login,
+			.cmd = trade.cmd,
+			.volume = trade.volume,
+			.state = trade.state,
+			.open_time = static_cast<int32_t>(trade.open_time),
+			.close_time = static_cast<int32_t>(trade.close_time),
+			.timestamp = static_cast<int32_t>(trade.timestamp),
+			.open_price = trade.open_price,
+			.sl = trade.sl,
+			.tp = trade.tp,
+			.close_price = trade.close_price,
+			.profit = trade.profit,
+			.commission = trade.commission,
+			.storage = trade.storage,
+			.conv_rate = trade.conv_rates[0],
+		};
+		strncpy(event.symbol, trade.symbol, sizeof(event.symbol) - 1);
+		strncpy(event.comment, trade.comment, sizeof(event.comment) - 1);
+		return event;
+	}
+
+	trade_event_stream::trade_event_stream(size_t capacity, size_t batch_size, size_t logins)
+		: m_queue{ capacity }
+		, m_batch_size{ std::max<size_t>(batch_size, 1) }
+		, m_sequences{ new login_sequence[std::bit_ceil(std::max<size_t>(logins, 16))] }
+		, m_sequences_mask{ std::bit_ceil(std::max<size_t>(logins, 16)) - 1 }
+		, m_batch{ .epoch = static_cast<int64_t>(std::time(nullptr)), .dropped = 0, .events = {} }
+	{
+		m_batch.events.reserve(m_batch_size);
+	}
+
+	bool trade_event_stream::push(trade_event event) noexcept
+	{
+		event.sequence = next_sequence(event.login);
+		if (m_queue.try_push(std::move(event)))
+		{
+			return true;
+		}
+		m_dropped.fetch_add(1, std::memory_order_relaxed);
+		m_lost.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+
+	const trade_event_batch& trade_event_stream::take()
+	{
+		m_batch.events.clear();
+		m_batch.dropped = m_dropped.exchange(0, std::memory_order_relaxed);
+
+		trade_event event{};
+		while (m_batch.events.size() < m_batch_size && m_queue.try_pop(event))
+		{
+			m_batch.events.push_back(event);
+		}
+		m_queue.publish_head();
+		// Two trade threads can push a login's numbers out of order, a batch puts them back in it.
+		// Stable, so unnumbered events keep their queue order.
+		std::stable_sort(m_batch.events.begin(), m_batch.events.end(), [](const trade_event& a, const trade_event& b)
+		{
+			return a.login != b.login ? a.login < b.login : a.sequence < b.sequence;
+		});
+		m_published.fetch_add(m_batch.events.size(), std::memory_order_relaxed);
+		return m_batch;
+	}
+
+	uint64_t trade_event_stream::next_sequence(int login) noexcept
+	{
+		if (login <= 0)
+		{
+			return 0;
+		}
+		const auto home = static_cast<size_t>((static_cast<uint64_t>(static_cast<uint32_t>(login)) * 0x9E3779B97F4A7C15ull) >> 32);
+		for (size_t index = home & m_sequences_mask, probes = 0; probes <= m_sequences_mask; index = (index + 1) & m_sequences_mask, ++probes)
+		{
+			auto& entry = m_sequences[index];
+			auto current = entry.login.load(std::memory_order_acquire);
+			if (current == 0)
+			{
+				// Claiming counts against the 3/4 limit first, so probes always end at a free slot.
+				if (m_sequences_used.fetch_add(1, std::memory_order_relaxed) >= (m_sequences_mask + 1) / 4 * 3)
+				{
+					m_sequences_used.fetch_sub(1, std::memory_order_relaxed);
+					return 0;
+				}
+				if (!entry.login.compare_exchange_strong(current, login, std::memory_order_acq_rel))
+				{
+					m_sequences_used.fetch_sub(1, std::memory_order_relaxed);
+				}
+				else
+				{
+					current = login;
+				}
+			}
+			if (current == login)
+			{
+				return entry.sequence.fetch_add(1, std::memory_order_relaxed) + 1;
+			}
+		}
+		return 0;
+	}
+}
\ No newline at end of file
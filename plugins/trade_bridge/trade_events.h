@@ -0,0 +1,75 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+#include "models.h"
+#include "mpsc_queue.h"
+
+struct TradeRecord;
+
+namespace mt4
+{
+	trade_event make_trade_event(const TradeRecord& trade, trade_event::event_kind kind) noexcept;
+
+	// Carries order events from the server's trade threads to the publisher. Pushing never
+	// blocks or allocates: a full queue drops the event and counts it, the next batch reports
+	// the gap. Events are numbered per login as they are pushed, before the queue can drop
+	// them, so a login's missing number is one of its events lost. Numbering and queueing are
+	// two steps, so concurrent pushes for one login can queue out of order: a batch is sorted by
+	// login and number, but a number can still arrive one batch after the next one.
+	class trade_event_stream
+	{
+	public:
+		// Logins sizes the sequence table like the account cache, rounded up to a power of two
+		// and filled up to 3/4 of it. Logins past that get sequence 0, unnumbered.
+		trade_event_stream(size_t capacity, size_t batch_size, size_t logins);
+
+		trade_event_stream(const trade_event_stream&) = delete;
+		trade_event_stream& operator= (const trade_event_stream&) = delete;
+
+		// Any thread.
+		bool push(trade_event event) noexcept;
+
+		// One publisher at a time, false while another one is draining.
+		bool try_acquire() noexcept { return !m_publishing.test_and_set(std::memory_order_acquire); }
+		void release() noexcept { m_publishing.clear(std::memory_order_release); }
+
+		// Publisher only: the next batch, empty with nothing dropped once the queue is drained.
+		const trade_event_batch& take();
+
+		bool idle() const noexcept { return m_queue.size() == 0 && m_dropped.load(std::memory_order_relaxed) == 0; }
+		size_t queued() const noexcept { return m_queue.size(); }
+		size_t batch_size() const noexcept { return m_batch_size; }
+
+		// Since the previous call, for the metrics log.
+		uint64_t published() noexcept { return m_published.exchange(0, std::memory_order_relaxed); }
+		uint64_t lost() noexcept { return m_lost.exchange(0, std::memory_order_relaxed); }
+
+	private:
+		// Slots are claimed with a CAS and never freed, a login keeps its slot for the epoch.
+		struct login_sequence
+		{
+			std::atomic<int>		login{ 0 };
+			std::atomic<uint64_t>	sequence{ 0 };
+		};
+
+		uint64_t next_sequence(int login) noexcept;
+
+		mpsc_queue<trade_event>				m_queue;
+		const size_t						m_batch_size;
+		std::atomic_flag					m_publishing{};
+
+		std::atomic<uint64_t>				m_dropped{ 0 };		// reported in the next batch
+		std::atomic<uint64_t>				m_lost{ 0 };
+		std::atomic<uint64_t>				m_published{ 0 };
+
+		std::unique_ptr<login_sequence[]>	m_sequences;
+		const size_t						m_sequences_mask;
+		std::atomic<size_t>					m_sequences_used{ 0 };
+
+		// Publisher only.
+		trade_event_batch					m_batch;
+	};
+}
\ No newline at end of file
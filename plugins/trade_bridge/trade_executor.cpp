@@ -0,0 +1,482 @@
+#include "trade_executor.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+#include <fmt/core.h>
+
+#include "account_cache.h"
+#include "config_store.h"
+#include "metrics.h"
+#include "models.h"
+
+#include "mt4.h"
+
+namespace
+{
+	using rejection = mt4::trade_rejection;
+
+	template<size_t Size>
+	void copy_string(char (&target)[Size], const std::string_view source)
+	{
+		const auto size = std::min(source.size(), Size - 1);
+		std::memcpy(target, source.data(), size);
+		target[size] = '\0';
+	}
+
+	int to_volume(double lots)
+	{
+		return static_cast<int>(std::lround(lots * 100.0));
+	}
+
+	void fill_user(const UserRecord& record, UserInfo& user)
+	{
+		user.login = record.login;
+		copy_string(user.group, record.group);
+		copy_string(user.name, record.name);
+		copy_string(user.ip, "mt4api");
+		user.enable = record.enable;
+		user.enable_read_only = record.enable_read_only;
+		user.leverage = record.leverage;
+		user.agent_account = record.agent_account;
+		user.balance = record.balance;
+		user.credit = record.credit;
+		user.prevbalance = record.prevbalance;
+	}
+
+	bool matches(mt4::mass_trade_request::action_type action, int cmd) noexcept
+	{
+		switch (action)
+		{
+		case mt4::mass_trade_request::CLOSE:
+			return cmd == OP_BUY || cmd == OP_SELL;
+		case mt4::mass_trade_request::CANCEL:
+			return cmd >= OP_BUY_LIMIT && cmd <= OP_SELL_STOP;
+		case mt4::mass_trade_request::MODIFY:
+			return cmd >= OP_BUY && cmd <= OP_SELL_STOP;
+		}
+		return false;
+	}
+
+	// prices[0] is bid, prices[1] is ask, both with the group spread applied.
+	tl::expected<void, rejection> group_prices(CServerInterface* mt4server, const char* symbol, const ConGroup& group, double (&prices)[2])
+	{
+		if (mt4server->HistoryPricesGroup(symbol, &group, prices) != RET_OK)
+		{
+			return tl::unexpected{ rejection{ RET_TRADE_OFFQUOTES, fmt::format("No quotes for '{}'", symbol) } };
+		}
+		return {};
+	}
+}
+
+namespace mt4
+{
+	trade_executor::trade_executor(CServerInterface* mt4server, const config_store& config, const registry& ids, const account_cache& accounts, logger& log,
+		trade_metrics& metrics, bool validation_parity) noexcept
+		: m_mt4server{ mt4server }
+		, m_config{ config }
+		, m_registry{ ids }
+		, m_accounts{ accounts }
+		, m_metrics{ metrics }
+		, m_validator{ mt4server, log, metrics, validation_parity }
+	{
+	}
+
+	trade_response trade_executor::execute(const trade_request& request)
+	{
+		trade_response response{
+			.request_id = request.request_id,
+			.order_id = 0,
+			.reject_code = RET_OK,
+			.reject_message = {}
+		};
+		const auto reject = [&](rejection&& error)
+		{
+			response.reject_code = error.code;
+			response.reject_message = std::move(error.message);
+			++m_metrics.rejected;
+			return response;
+		};
+
+		const auto started = std::chrono::steady_clock::now();
+		// One view for the whole request, so the checks and the order see the same configuration.
+		const auto view = m_config.view();
+		UserInfo user{};
+		const group_masks* masks{ nullptr };
+		if (auto resolved = resolve_user(*view, request.login, user, masks); !resolved)
+		{
+			return reject(std::move(resolved.error()));
+		}
+		const auto resolved_at = std::chrono::steady_clock::now();
+		m_metrics.resolve.record(resolved_at - started);
+
+		auto order = [&]() -> tl::expected<int, rejection>
+		{
+			switch (request.type)
+			{
+			case trade_request::NEW: return open(*view, request, user, masks);
+			case trade_request::CLOSE: return close(*view, request, user, masks);
+			case trade_request::CANCEL: return cancel(request, user);
+			case trade_request::MODIFY: return modify(*view, request, user);
+			}
+			return tl::unexpected{ rejection{ RET_INVALID_DATA, fmt::format("Unknown request type {}", static_cast<int>(request.type)) } };
+		}();
+		m_metrics.execute.record(std::chrono::steady_clock::now() - resolved_at);
+		if (!order)
+		{
+			return reject(std::move(order.error()));
+		}
+
+		response.order_id = *order;
+		++m_metrics.accepted;
+		return response;
+	}
+
+	tl::expected<void, trade_executor::rejection> trade_executor::resolve_user(const config_view& view, int login, UserInfo& user, const group_masks*& masks) const
+	{
+		// Unknown and disabled logins are turned away by the account cache, only the others cost a server call.
+		const auto cached = m_accounts.ready() ? m_accounts.find(login) : std::nullopt;
+		if (m_accounts.ready() && !cached)
+		{
+			return tl::unexpected{ rejection{ RET_INVALID_DATA, fmt::format("Unknown login {}", login) } };
+		}
+		if (cached && (!cached->enabled || cached->read_only))
+		{
+			return tl::unexpected{ rejection{ RET_TRADE_DISABLE, fmt::format("Trading is disabled for login {}", login) } };
+		}
+
+		// Orders are checked against the current balance, which only the full record has.
+		UserRecord record{};
+		if (m_mt4server->ClientsUserInfo(login, &record) == FALSE)
+		{
+			return tl::unexpected{ rejection{ RET_INVALID_DATA, fmt::format("Unknown login {}", login) } };
+		}
+		if (record.enable == FALSE || record.enable_read_only != FALSE)
+		{
+			return tl::unexpected{ rejection{ RET_TRADE_DISABLE, fmt::format("Trading is disabled for login {}", login) } };
+		}
+
+		fill_user(record, user);
+
+		// The cached group is current as of the last MtSrvGroupsAdd, ask the server only if it is unknown.
+		const auto id = cached && cached->group != invalid_id ? cached->group : m_registry.groups.find(record.group);
+		if (const auto group = view.group(id); group != nullptr)
+		{
+			user.grp = *group;
+			masks = view.masks(id);
+		}
+		else if (m_mt4server->GroupsGet(record.group, &user.grp) == FALSE)
+		{
+			return tl::unexpected{ rejection{ RET_ERROR, fmt::format("Unknown group '{}' of login {}", record.group, login) } };
+		}
+		return {};
+	}
+
+	tl::expected<int, trade_executor::rejection> trade_executor::open(const config_view& view, const trade_request& request, UserInfo& user, const group_masks* masks) const
+	{
+		const auto id = m_registry.symbols.find(request.symbol);
+		const auto symbol = view.symbol(id);
+		if (symbol == nullptr)
+		{
+			return tl::unexpected{ rejection{ RET_INVALID_DATA, fmt::format("Unknown symbol '{}'", request.symbol) } };
+		}
+		const auto volume = to_volume(request.volume);
+		if (volume <= 0)
+		{
+			return tl::unexpected{ rejection{ RET_TRADE_BAD_VOLUME, fmt::format("Invalid volume {}", request.volume) } };
+		}
+
+		TradeTransInfo trans{};
+		trans.type = TT_ORDER_MK_OPEN;
+		trans.cmd = request.side == trade_request::BUY ? OP_BUY : OP_SELL;
+		copy_string(trans.symbol, symbol->symbol);
+		trans.volume = volume;
+		trans.sl = request.sl;
+		trans.tp = request.tp;
+		copy_string(trans.comment, request.comment);
+		if (auto status = validate(trans, *symbol, id, user, masks); !status)
+		{
+			return tl::unexpected{ std::move(status.error()) };
+		}
+
+		double prices[2]{};
+		if (auto status = group_prices(m_mt4server, symbol->symbol, user.grp, prices); !status)
+		{
+			return tl::unexpected{ std::move(status.error()) };
+		}
+		trans.price = request.side == trade_request::BUY ? prices[1] : prices[0];
+		if (auto status = m_validator.validate_stops(trans, *symbol, user.grp, prices); !status)
+		{
+			return tl::unexpected{ std::move(status.error()) };
+		}
+
+		const auto order = m_mt4server->OrdersOpen(&trans, &user);
+		if (order <= 0)
+		{
+			return tl::unexpected{ rejection{ server_reject_code(trans, user, nullptr), fmt::format("Server rejected {} {} {} for login {}",
+				request.side == trade_request::BUY ? "buy" : "sell", request.volume, request.symbol, request.login) } };
+		}
+		return order;
+	}
+
+	tl::expected<int, trade_executor::rejection> trade_executor::close(const config_view& view, const trade_request& request, UserInfo& user, const group_masks* masks) const
+	{
+		TradeRecord trade{};
+		if (auto found = find_order(request, trade); !found)
+		{
+			return tl::unexpected{ std::move(found.error()) };
+		}
+		if (trade.cmd != OP_BUY && trade.cmd != OP_SELL)
+		{
+			return tl::unexpected{ rejection{ RET_INVALID_DATA, fmt::format("Order {} is not an open position", request.order) } };
+		}
+
+		// A zero volume closes the whole position.
+		const auto volume = to_volume(request.volume);
+
+		TradeTransInfo trans{};
+		trans.type = TT_ORDER_MK_CLOSE;
+		trans.cmd = static_cast<short>(trade.cmd);
+		trans.order = trade.order;
+		copy_string(trans.symbol, trade.symbol);
+		trans.volume = volume > 0 ? std::min(volume, trade.volume) : trade.volume;
+		copy_string(trans.comment, request.comment);
+		// A symbol missing from the cache is left to the server to judge.
+		const auto id = m_registry.symbols.find(trade.symbol);
+		if (const auto symbol = view.symbol(id); symbol != nullptr)
+		{
+			if (auto status = validate(trans, *symbol, id, user, masks); !status)
+			{
+				return tl::unexpected{ std::move(status.error()) };
+			}
+		}
+
+		double prices[2]{};
+		if (auto status = group_prices(m_mt4server, trade.symbol, user.grp, prices); !status)
+		{
+			return tl::unexpected{ std::move(status.error()) };
+		}
+		trans.price = trade.cmd == OP_BUY ? prices[0] : prices[1];
+
+		if (m_mt4server->OrdersClose(&trans, &user) == FALSE)
+		{
+			return tl::unexpected{ rejection{ server_reject_code(trans, user, &trade),
+				fmt::format("Server rejected closing order {} for login {}", request.order, request.login) } };
+		}
+		return trade.order;
+	}
+
+	tl::expected<int, trade_executor::rejection> trade_executor::cancel(const trade_request& request, UserInfo& user) const
+	{
+		TradeRecord trade{};
+		if (auto found = find_order(request, trade); !found)
+		{
+			return tl::unexpected{ std::move(found.error()) };
+		}
+		if (trade.cmd < OP_BUY_LIMIT || trade.cmd > OP_SELL_STOP)
+		{
+			return tl::unexpected{ rejection{ RET_INVALID_DATA, fmt::format("Order {} is not a pending order", request.order) } };
+		}
+		if (m_mt4server->OrdersUpdate(&trade, &user, UPDATE_DELETE) == FALSE)
+		{
+			TradeTransInfo trans{};
+			trans.type = TT_ORDER_DELETE;
+			trans.cmd = static_cast<short>(trade.cmd);
+			trans.order = trade.order;
+			copy_string(trans.symbol, trade.symbol);
+			trans.volume = trade.volume;
+			return tl::unexpected{ rejection{ server_reject_code(trans, user, &trade),
+				fmt::format("Server rejected cancelling order {} for login {}", request.order, request.login) } };
+		}
+		return trade.order;
+	}
+
+	// Zero sl or tp removes that level, as in the terminal.
+	tl::expected<int, trade_executor::rejection> trade_executor::modify(const config_view& view, const trade_request& request, UserInfo& user) const
+	{
+		TradeRecord trade{};
+		if (auto found = find_order(request, trade); !found)
+		{
+			return tl::unexpected{ std::move(found.error()) };
+		}
+		if (trade.cmd < OP_BUY || trade.cmd > OP_SELL_STOP)
+		{
+			return tl::unexpected{ rejection{ RET_INVALID_DATA, fmt::format("Order {} can't be modified", request.order) } };
+		}
+
+		TradeTransInfo trans{};
+		trans.type = TT_ORDER_MODIFY;
+		trans.cmd = static_cast<short>(trade.cmd);
+		trans.order = trade.order;
+		copy_string(trans.symbol, trade.symbol);
+		trans.volume = trade.volume;
+		trans.price = trade.open_price;
+		trans.sl = request.sl;
+		trans.tp = request.tp;
+
+		// Pending order stops are relative to the order price, only positions are checked against quotes.
+		const auto symbol = view.symbol(m_registry.symbols.find(trade.symbol));
+		if (symbol != nullptr && (trade.cmd == OP_BUY || trade.cmd == OP_SELL))
+		{
+			double prices[2]{};
+			if (auto status = group_prices(m_mt4server, trade.symbol, user.grp, prices); !status)
+			{
+				return tl::unexpected{ std::move(status.error()) };
+			}
+			if (auto status = m_validator.validate_stops(trans, *symbol, user.grp, prices); !status)
+			{
+				return tl::unexpected{ std::move(status.error()) };
+			}
+		}
+
+		const auto original = trade;
+		trade.sl = request.sl;
+		trade.tp = request.tp;
+		if (m_mt4server->OrdersUpdate(&trade, &user, UPDATE_NORMAL) == FALSE)
+		{
+			return tl::unexpected{ rejection{ server_reject_code(trans, user, &original),
+				fmt::format("Server rejected modifying order {} for login {}", request.order, request.login) } };
+		}
+		return trade.order;
+	}
+
+	std::vector<trade_request> trade_executor::collect_targets(const mass_trade_request& request) const
+	{
+		std::vector<UserRecord> users{};
+		if (!request.logins.empty())
+		{
+			users.reserve(request.logins.size());
+			for (const auto login : request.logins)
+			{
+				// Unknown logins have nothing to act on.
+				if (UserRecord record{}; m_mt4server->ClientsUserInfo(login, &record) != FALSE)
+				{
+					users.push_back(record);
+				}
+			}
+		}
+		else
+		{
+			int total{ 0 };
+			const heap_array_t<UserRecord> records{ m_mt4server->ClientsGroupsUsers(&total, request.groups.c_str()) };
+			if (records)
+			{
+				users.assign(records.get(), records.get() + total);
+			}
+		}
+
+		const auto type = request.action == mass_trade_request::CLOSE ? trade_request::CLOSE
+			: request.action == mass_trade_request::CANCEL ? trade_request::CANCEL : trade_request::MODIFY;
+		std::vector<trade_request> targets{};
+		for (const auto& record : users)
+		{
+			UserInfo user{};
+			fill_user(record, user);
+			int total{ 0 };
+			const heap_array_t<TradeRecord> trades{ m_mt4server->OrdersGetOpen(&user, &total) };
+			for (int i = 0; trades && i < total; ++i)
+			{
+				const auto& trade = trades[i];
+				if (!matches(request.action, trade.cmd) || (!request.symbol.empty() && request.symbol != trade.symbol))
+				{
+					continue;
+				}
+				// Numbered within the operation, so each target has its own journal entry.
+				targets.push_back(trade_request{
+					.request_id = static_cast<int>(targets.size() + 1),
+					.type = type,
+					.side = trade_request::BUY,
+					.login = trade.login,
+					.volume = 0.0,
+					.sl = request.sl.value_or(trade.sl),
+					.tp = request.tp.value_or(trade.tp),
+					.symbol = trade.symbol,
+					.comment = request.comment,
+					.order = trade.order
+				});
+			}
+		}
+		return targets;
+	}
+
+	// The ticket must belong to the requesting login and still be open.
+	tl::expected<void, trade_executor::rejection> trade_executor::find_order(const trade_request& request, TradeRecord& trade) const
+	{
+		if (m_mt4server->OrdersGet(request.order, &trade) == FALSE || trade.login != request.login)
+		{
+			return tl::unexpected{ rejection{ RET_INVALID_DATA, fmt::format("Order {} not found for login {}", request.order, request.login) } };
+		}
+		if (trade.close_time != 0)
+		{
+			return tl::unexpected{ rejection{ RET_INVALID_DATA, fmt::format("Order {} is already closed", request.order) } };
+		}
+		return {};
+	}
+
+	// Groups missing from the cache come from GroupsGet, their masks are derived on the spot.
+	tl::expected<void, trade_executor::rejection> trade_executor::validate(const TradeTransInfo& trans, const ConSymbol& symbol, symbol_id id, const UserInfo& user, const group_masks* masks) const
+	{
+		if (masks != nullptr)
+		{
+			return m_validator.validate(trans, symbol, user.grp, *masks, id);
+		}
+		group_masks derived{};
+		set_symbol_masks(derived, user.grp, id, &symbol);
+		return m_validator.validate(trans, symbol, user.grp, derived, id);
+	}
+	// OrdersOpen, OrdersClose and OrdersUpdate answer with a ticket or FALSE only. The server's
+	// own checks, run again on the failed order, tell which of its return codes applies.
+	int trade_executor::server_reject_code(const TradeTransInfo& trans, const UserInfo& user, const TradeRecord* trade) const
+	{
+		ConSymbol symbol{};
+		if (m_mt4server->SymbolsGet(trans.symbol, &symbol) == FALSE)
+		{
+			return RET_INVALID_DATA;
+		}
+		if (const auto code = m_mt4server->TradesCheckSecurity(&symbol, &user.grp); code != RET_OK)
+		{
+			return code;
+		}
+		if (m_mt4server->TradesCheckSessions(&symbol, m_mt4server->TradeTime()) == FALSE)
+		{
+			return RET_TRADE_MARKET_CLOSED;
+		}
+		if (double prices[2]{}; m_mt4server->HistoryPricesGroup(trans.symbol, &user.grp, prices) != RET_OK)
+		{
+			return RET_TRADE_OFFQUOTES;
+		}
+		if (trade != nullptr)
+		{
+			if (const auto code = m_mt4server->TradesCheckFreezed(&symbol, &user.grp, trade); code != RET_OK)
+			{
+				return code;
+			}
+		}
+		if (trans.type == TT_ORDER_MK_OPEN || trans.type == TT_ORDER_MK_CLOSE)
+		{
+			const auto opening = trans.type == TT_ORDER_MK_OPEN ? TRUE : FALSE;
+			if (const auto code = m_mt4server->TradesCheckVolume(&trans, &symbol, &user.grp, opening); code != RET_OK)
+			{
+				return code;
+			}
+		}
+		if (trans.type == TT_ORDER_MK_OPEN || trans.type == TT_ORDER_MODIFY)
+		{
+			if (const auto code = m_mt4server->TradesCheckStops(&trans, &symbol, &user.grp, trade); code != RET_OK)
+			{
+				return code;
+			}
+		}
+		if (trans.type == TT_ORDER_MK_OPEN)
+		{
+			double profit{ 0.0 }, free_margin{ 0.0 }, previous_margin{ 0.0 };
+			m_mt4server->TradesMarginCheck(&user, &trans, &profit, &free_margin, &previous_margin);
+			if (free_margin < 0.0)
+			{
+				return RET_TRADE_NO_MONEY;
+			}
+		}
+		return RET_ERROR;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <tl/expected.hpp>
+
+#include "registry.h"
+#include "trade_validator.h"
+
+struct CServerInterface;
+struct UserInfo;
+struct ConSymbol;
+struct TradeTransInfo;
+struct TradeRecord;
+
+namespace mt4
+{
+	class account_cache;
+	class config_store;
+	class config_view;
+	class logger;
+	struct trade_request;
+	struct mass_trade_request;
+	struct trade_response;
+	struct trade_metrics;
+
+	// Turns trade requests into server orders. The server API is thread safe, so a single
+	// executor serves every trade worker.
+	class trade_executor
+	{
+	public:
+		using rejection = trade_rejection;
+
+		// With validation_parity every local check is repeated by the server and compared.
+		trade_executor(CServerInterface* mt4server, const config_store& config, const registry& ids, const account_cache& accounts, logger& log,
+			trade_metrics& metrics, bool validation_parity) noexcept;
+
+		trade_response execute(const trade_request& request);
+
+		// Open orders a mass operation applies to, as requests for execute.
+		std::vector<trade_request> collect_targets(const mass_trade_request& request) const;
+
+	private:
+		tl::expected<void, rejection> resolve_user(const config_view& view, int login, UserInfo& user, const group_masks*& masks) const;
+		tl::expected<int, rejection> open(const config_view& view, const trade_request& request, UserInfo& user, const group_masks* masks) const;
+		tl::expected<int, rejection> close(const config_view& view, const trade_request& request, UserInfo& user, const group_masks* masks) const;
+		tl::expected<int, rejection> cancel(const trade_request& request, UserInfo& user) const;
+		tl::expected<int, rejection> modify(const config_view& view, const trade_request& request, UserInfo& user) const;
+		tl::expected<void, rejection> find_order(const trade_request& request, TradeRecord& trade) const;
+		tl::expected<void, rejection> validate(const TradeTransInfo& trans, const ConSymbol& symbol, symbol_id id, const UserInfo& user, const group_masks* masks) const;
+		// Why the server turned down an order call. Trade is the order being changed, null for a new one.
+		int server_reject_code(const TradeTransInfo& trans, const UserInfo& user, const TradeRecord* trade) const;
+
+		CServerInterface*		m_mt4server;
+		const config_store&		m_config;
+		const registry&			m_registry;
+		const account_cache&	m_accounts;
+		trade_metrics&			m_metrics;
+		trade_validator			m_validator;
+	};
+}
\ No newline at end of file
@@ -0,0 +1,273 @@
+#include "trade_journal.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_set>
+
+#include <fmt/core.h>
+
+#include "models.h"
+#include "tools.h"
+
+#include "mt4.h"
+
+namespace
+{
+	using record = mt4::trade_journal::record;
+
+	constexpr size_t read_chunk_records = 4096;
+
+	uint32_t checksum_of(record entry) noexcept
+	{
+		entry.checksum = 0;
+		return static_cast<uint32_t>(tools::hash_bytes(&entry, sizeof(entry)));
+	}
+
+	template<size_t Size>
+	void copy_string(char (&target)[Size], const std::string_view source)
+	{
+		const auto size = std::min(source.size(), Size - 1);
+		std::memcpy(target, source.data(), size);
+		target[size] = '\0';
+	}
+
+	OVERLAPPED at_offset(uint64_t offset) noexcept
+	{
+		OVERLAPPED overlapped{};
+		overlapped.Offset = static_cast<DWORD>(offset & 0xFFFFFFFF);
+		overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+		return overlapped;
+	}
+}
+
+namespace mt4
+{
+	trade_journal::trade_journal() noexcept
+		: m_file{ INVALID_HANDLE_VALUE }
+	{
+	}
+
+	trade_journal::~trade_journal()
+	{
+		if (m_committer.joinable())
+		{
+			{
+				std::lock_guard lock{ m_mutex };
+				m_stopping = true;
+			}
+			m_pending_cv.notify_one();
+			m_committer.join();
+		}
+		if (m_file != INVALID_HANDLE_VALUE)
+		{
+			CloseHandle(m_file);
+		}
+	}
+
+	tl::expected<void, std::string> trade_journal::open(const std::filesystem::path& path, size_t records_total,
+		std::chrono::microseconds commit_interval, size_t commit_records)
+	{
+		const auto file = CreateFileA(path.string().c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr,
+			OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+		{
+			return tl::unexpected{ fmt::format("CreateFile failed, error: {}", GetLastError()) };
+		}
+		m_file = file;
+
+		// Slots are lsn-addressed, so resizing would scatter the previous run's records.
+		LARGE_INTEGER size{};
+		GetFileSizeEx(file, &size);
+		auto capacity = static_cast<size_t>(size.QuadPart) / sizeof(record);
+		if (capacity == 0)
+		{
+			capacity = std::max<size_t>(records_total, 1024);
+			LARGE_INTEGER end{};
+			end.QuadPart = static_cast<long long>(capacity * sizeof(record));
+			if (SetFilePointerEx(file, end, nullptr, FILE_BEGIN) == FALSE || SetEndOfFile(file) == FALSE)
+			{
+				return tl::unexpected{ fmt::format("Failed to pre-allocate {} records, error: {}", capacity, GetLastError()) };
+			}
+		}
+		m_capacity = capacity;
+		m_commit_interval = commit_interval;
+		m_commit_records = std::max<size_t>(commit_records, 1);
+
+		if (auto status = recover(); !status)
+		{
+			m_capacity = 0;
+			return status;
+		}
+		m_committer = std::thread{ [this]() { run(); } };
+		return {};
+	}
+
+	tl::expected<void, std::string> trade_journal::recover()
+	{
+		std::vector<record> accepted{};
+		std::unordered_set<uint64_t> completed{};
+		uint64_t last_lsn{ 0 };
+
+		std::vector<record> chunk(read_chunk_records);
+		for (size_t first = 0; first < m_capacity; first += read_chunk_records)
+		{
+			const auto count = std::min(read_chunk_records, m_capacity - first);
+			auto overlapped = at_offset(first * sizeof(record));
+			DWORD read{ 0 };
+			if (ReadFile(m_file, chunk.data(), static_cast<DWORD>(count * sizeof(record)), &read, &overlapped) == FALSE)
+			{
+				return tl::unexpected{ fmt::format("ReadFile failed, error: {}", GetLastError()) };
+			}
+			for (size_t i = 0; i < read / sizeof(record); ++i)
+			{
+				const auto& entry = chunk[i];
+				// Torn writes of a crash fail the checksum and are ignored.
+				if (entry.magic != magic || entry.checksum != checksum_of(entry))
+				{
+					continue;
+				}
+				last_lsn = std::max(last_lsn, entry.lsn);
+				if (entry.kind == ACCEPTED)
+				{
+					accepted.push_back(entry);
+				}
+				else if (entry.kind == COMPLETED)
+				{
+					completed.insert(entry.accepted_lsn);
+				}
+			}
+		}
+
+		// A completion always follows its acceptance, so it can't have been overwritten while the acceptance survived.
+		for (const auto& entry : accepted)
+		{
+			if (!completed.contains(entry.lsn))
+			{
+				m_unfinished.push_back(entry);
+			}
+		}
+		std::sort(m_unfinished.begin(), m_unfinished.end(), [](const record& lhs, const record& rhs) { return lhs.lsn < rhs.lsn; });
+
+		m_next_lsn = last_lsn + 1;
+		m_durable_lsn.store(last_lsn, std::memory_order_relaxed);
+		return {};
+	}
+
+	trade_journal::record trade_journal::accepted(const trade_request& request, int32_t server_time, int32_t operation_id)
+	{
+		record entry{};
+		entry.operation_id = operation_id;
+		entry.kind = ACCEPTED;
+		entry.type = static_cast<uint8_t>(request.type);
+		entry.side = static_cast<uint8_t>(request.side);
+		entry.request_id = request.request_id;
+		entry.login = request.login;
+		entry.order = request.order;
+		entry.volume = static_cast<int32_t>(std::lround(request.volume * 100.0));
+		entry.accepted_at = server_time;
+		entry.sl = request.sl;
+		entry.tp = request.tp;
+		copy_string(entry.symbol, request.symbol);
+		copy_string(entry.comment, request.comment);
+		return entry;
+	}
+
+	trade_journal::record trade_journal::completed(const record& accepted, const trade_response& response)
+	{
+		auto entry = accepted;
+		entry.kind = COMPLETED;
+		entry.accepted_lsn = accepted.lsn;
+		entry.result_order = response.order_id;
+		entry.reject_code = response.reject_code;
+		return entry;
+	}
+
+	uint64_t trade_journal::append(record entry)
+	{
+		if (!is_open())
+		{
+			return 0;
+		}
+		std::unique_lock lock{ m_mutex };
+		entry.magic = magic;
+		entry.lsn = m_next_lsn++;
+		if (entry.kind == ACCEPTED)
+		{
+			entry.accepted_lsn = entry.lsn;
+		}
+		entry.checksum = 0;
+		entry.checksum = checksum_of(entry);
+		m_pending.push_back(entry);
+		const auto wake = m_pending.size() == 1 || m_pending.size() >= m_commit_records;
+		lock.unlock();
+		if (wake)
+		{
+			m_pending_cv.notify_one();
+		}
+		return entry.lsn;
+	}
+
+	void trade_journal::wait_durable(uint64_t lsn)
+	{
+		for (auto durable = m_durable_lsn.load(std::memory_order_acquire); durable < lsn; durable = m_durable_lsn.load(std::memory_order_acquire))
+		{
+			m_durable_lsn.wait(durable, std::memory_order_acquire);
+		}
+	}
+
+	void trade_journal::run()
+	{
+		std::vector<record> batch{};
+		std::unique_lock lock{ m_mutex };
+		while (!m_stopping || !m_pending.empty())
+		{
+			m_pending_cv.wait(lock, [this]() { return m_stopping || !m_pending.empty(); });
+
+			// Linger for more records; the interval is in microseconds, below what a timed wait can resolve.
+			const auto deadline = std::chrono::steady_clock::now() + m_commit_interval;
+			while (!m_stopping && m_pending.size() < m_commit_records && std::chrono::steady_clock::now() < deadline)
+			{
+				lock.unlock();
+				std::this_thread::yield();
+				lock.lock();
+			}
+			if (m_pending.empty())
+			{
+				continue;
+			}
+			batch.swap(m_pending);
+			lock.unlock();
+
+			if (!write(batch))
+			{
+				m_failures.fetch_add(1, std::memory_order_relaxed);
+			}
+			m_commits.fetch_add(1, std::memory_order_relaxed);
+			m_durable_lsn.store(batch.back().lsn, std::memory_order_release);
+			m_durable_lsn.notify_all();
+			batch.clear();
+
+			lock.lock();
+		}
+	}
+
+	// Records of a batch have consecutive lsns, so they take at most two runs of slots.
+	bool trade_journal::write(const std::vector<record>& batch)
+	{
+		size_t written{ 0 };
+		while (written < batch.size())
+		{
+			const auto slot = (batch[written].lsn - 1) % m_capacity;
+			const auto count = std::min(batch.size() - written, m_capacity - slot);
+			auto overlapped = at_offset(slot * sizeof(record));
+			DWORD done{ 0 };
+			if (WriteFile(m_file, &batch[written], static_cast<DWORD>(count * sizeof(record)), &done, &overlapped) == FALSE)
+			{
+				return false;
+			}
+			written += count;
+		}
+		return FlushFileBuffers(m_file) != FALSE;
+	}
+}
\ No newline at end of file
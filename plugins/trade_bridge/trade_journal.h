@@ -0,0 +1,118 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <tl/expected.hpp>
+
+namespace mt4
+{
+	struct trade_request;
+	struct trade_response;
+
+	// Write-ahead journal of trade requests and their outcomes. A request is recorded as accepted
+	// before it reaches the server and as completed once answered, so after a crash the accepted
+	// records without an outcome are exactly the requests whose fate is unknown.
+	//
+	// The file is a pre-allocated ring of fixed-size records. Appends only copy into memory; a
+	// committer thread writes and flushes them in groups, after commit_interval or as soon as
+	// commit_records are pending, so one FlushFileBuffers covers many trades.
+	class trade_journal
+	{
+	public:
+		static constexpr uint32_t magic = 0x4A34544D; // "MT4J"
+
+		enum record_kind : uint8_t
+		{
+			ACCEPTED = 1,
+			COMPLETED
+		};
+
+		struct record
+		{
+			uint32_t		magic;
+			uint32_t		checksum;		// of the record with this field zeroed
+			uint64_t		lsn;			// 1-based, the ring slot is (lsn - 1) % capacity
+			uint64_t		accepted_lsn;	// the request's accepted record, own lsn for ACCEPTED
+			uint8_t			kind;
+			uint8_t			type;			// trade_request::request_type
+			uint8_t			side;
+			uint8_t			reserved;
+			int32_t			request_id;
+			int32_t			login;
+			int32_t			order;
+			int32_t			volume;			// hundredths of a lot
+			int32_t			accepted_at;	// server time
+			int32_t			result_order;	// COMPLETED only
+			int32_t			reject_code;	// COMPLETED only
+			double			sl;
+			double			tp;
+			char			symbol[12];
+			char			comment[32];
+			int32_t			operation_id;	// mass operation of a target, 0 for client requests
+			char			padding[8];
+		};
+		static_assert(sizeof(record) == 128);
+
+		trade_journal() noexcept;
+		~trade_journal();
+
+		trade_journal(const trade_journal&) = delete;
+		trade_journal& operator= (const trade_journal&) = delete;
+
+		// An existing file keeps its size, records_total applies to new files only.
+		tl::expected<void, std::string> open(const std::filesystem::path& path, size_t records_total,
+			std::chrono::microseconds commit_interval, size_t commit_records);
+
+		bool is_open() const noexcept { return m_capacity != 0; }
+
+		// Accepted records of the previous run that never got an outcome.
+		const std::vector<record>& unfinished() const noexcept { return m_unfinished; }
+
+		// Targets of a mass operation carry its id, their request id numbers them within it.
+		static record accepted(const trade_request& request, int32_t server_time, int32_t operation_id = 0);
+		static record completed(const record& accepted, const trade_response& response);
+
+		// Returns the record's lsn, 0 when the journal is not open.
+		uint64_t append(record entry);
+
+		// Blocks until the record is on disk.
+		void wait_durable(uint64_t lsn);
+
+		// Group commits since the previous call.
+		uint64_t commits() noexcept { return m_commits.exchange(0, std::memory_order_relaxed); }
+
+		// Failed group commits since the previous call. Trading goes on without durability then,
+		// waiters are released as if the write had succeeded.
+		uint64_t failures() noexcept { return m_failures.exchange(0, std::memory_order_relaxed); }
+
+	private:
+		tl::expected<void, std::string> recover();
+		void run();
+		bool write(const std::vector<record>& batch);
+
+		void*						m_file;
+		size_t						m_capacity{ 0 };		// records, 0 while closed
+		std::chrono::microseconds	m_commit_interval{ 0 };
+		size_t						m_commit_records{ 1 };
+		std::vector<record>			m_unfinished;
+
+		std::mutex					m_mutex;
+		std::condition_variable		m_pending_cv;
+		std::vector<record>			m_pending;
+		uint64_t					m_next_lsn{ 1 };
+		bool						m_stopping{ false };
+
+		std::atomic<uint64_t>		m_durable_lsn{ 0 };
+		std::atomic<uint64_t>		m_commits{ 0 };
+		std::atomic<uint64_t>		m_failures{ 0 };
+		std::thread					m_committer;
+	};
+}
\ No newline at end of file
@@ -0,0 +1,216 @@
+#include "trade_validator.h"
+
+#include <chrono>
+
+#include <fmt/core.h>
+
+#include "config_store.h"
+#include "logger.h"
+#include "metrics.h"
+
+#include "mt4.h"
+
+namespace
+{
+	using rejection = mt4::trade_rejection;
+
+	constexpr time_t seconds_per_day = 24 * 60 * 60;
+
+	const ConGroupSec* sec_group_of(const ConSymbol& symbol, const ConGroup& group)
+	{
+		return symbol.type >= 0 && symbol.type < MAX_SEC_GROUPS ? &group.secgroups[symbol.type] : nullptr;
+	}
+
+	bool is_opening(const TradeTransInfo& trans)
+	{
+		return trans.type == TT_ORDER_MK_OPEN;
+	}
+
+	// Unused session slots are all zeros; 24:00 closes a session at the end of the day.
+	bool in_session(const ConSession& session, int minute)
+	{
+		const auto open = session.open_hour * 60 + session.open_min;
+		const auto close = session.close_hour * 60 + session.close_min;
+		return open < close && open <= minute && minute < close;
+	}
+}
+
+namespace mt4
+{
+	trade_validator::trade_validator(CServerInterface* mt4server, logger& log, trade_metrics& metrics, bool parity) noexcept
+		: m_mt4server{ mt4server }
+		, m_logger{ log }
+		, m_metrics{ metrics }
+		, m_parity{ parity }
+	{
+	}
+
+	trade_validator::result_t trade_validator::validate(const TradeTransInfo& trans, const ConSymbol& symbol, const ConGroup& group, const group_masks& masks, symbol_id id) const
+	{
+		const auto started = std::chrono::steady_clock::now();
+
+		auto result = check_rights(symbol, group);
+		if (m_parity)
+		{
+			result = compare("security", trans, std::move(result), m_mt4server->TradesCheckSecurity(&symbol, &group));
+		}
+		if (result)
+		{
+			// The server has no separate call for the trade mode, OrdersOpen checks it itself.
+			result = check_mode(trans, symbol, masks, id);
+		}
+		if (result)
+		{
+			result = check_volume(trans, symbol, group);
+			if (m_parity)
+			{
+				result = compare("volume", trans, std::move(result),
+					m_mt4server->TradesCheckVolume(&trans, &symbol, &group, is_opening(trans) ? TRUE : FALSE));
+			}
+		}
+		if (result)
+		{
+			const auto now = m_mt4server->TradeTime();
+			result = check_session(symbol, now);
+			if (m_parity)
+			{
+				// Unlike the other checks, TradesCheckSessions answers with a boolean.
+				result = compare("session", trans, std::move(result),
+					m_mt4server->TradesCheckSessions(&symbol, now) != FALSE ? RET_OK : RET_TRADE_MARKET_CLOSED);
+			}
+		}
+
+		m_metrics.validate.record(std::chrono::steady_clock::now() - started);
+		return result;
+	}
+
+	trade_validator::result_t trade_validator::validate_stops(const TradeTransInfo& trans, const ConSymbol& symbol, const ConGroup& group, const double (&prices)[2]) const
+	{
+		auto result = check_stops(trans, symbol, prices);
+		if (m_parity)
+		{
+			result = compare("stops", trans, std::move(result), m_mt4server->TradesCheckStops(&trans, &symbol, &group, nullptr));
+		}
+		return result;
+	}
+
+	trade_validator::result_t trade_validator::check_rights(const ConSymbol& symbol, const ConGroup& group)
+	{
+		const auto sec = sec_group_of(symbol, group);
+		if (sec == nullptr || sec->show == 0 || sec->trade == 0)
+		{
+			return tl::unexpected{ rejection{ RET_TRADE_DISABLE, fmt::format("Group '{}' has no trade rights for '{}'", group.group, symbol.symbol) } };
+		}
+		return {};
+	}
+
+	trade_validator::result_t trade_validator::check_mode(const TradeTransInfo& trans, const ConSymbol& symbol, const group_masks& masks, symbol_id id)
+	{
+		if (!is_opening(trans))
+		{
+			if (!masks.tradeable.test(id) && !masks.close_only.test(id))
+			{
+				return tl::unexpected{ rejection{ RET_TRADE_DISABLE, fmt::format("Trading is disabled for '{}'", symbol.symbol) } };
+			}
+			return {};
+		}
+		if (masks.long_only.test(id) && trans.cmd == OP_SELL)
+		{
+			return tl::unexpected{ rejection{ RET_TRADE_LONG_ONLY, fmt::format("Only buy positions can be opened for '{}'", symbol.symbol) } };
+		}
+		if (!masks.tradeable.test(id))
+		{
+			return tl::unexpected{ rejection{ RET_TRADE_DISABLE, masks.close_only.test(id)
+				? fmt::format("Only closing is allowed for '{}'", symbol.symbol)
+				: fmt::format("Trading is disabled for '{}'", symbol.symbol) } };
+		}
+		return {};
+	}
+
+	// Volumes and the group lot limits are both in hundredths of a lot.
+	trade_validator::result_t trade_validator::check_volume(const TradeTransInfo& trans, const ConSymbol& symbol, const ConGroup& group)
+	{
+		const auto sec = sec_group_of(symbol, group);
+		const auto bad_volume = [&trans](const char* reason)
+		{
+			return tl::unexpected{ rejection{ RET_TRADE_BAD_VOLUME, fmt::format("Volume {:.2f} is {}", trans.volume / 100.0, reason) } };
+		};
+		if (sec == nullptr || trans.volume <= 0)
+		{
+			return bad_volume("invalid");
+		}
+		// A closing may leave a remainder below the minimum, the server checks the minimum for openings only.
+		if (is_opening(trans) && trans.volume < sec->lot_min)
+		{
+			return bad_volume("below the group minimum");
+		}
+		if (sec->lot_max > 0 && trans.volume > sec->lot_max)
+		{
+			return bad_volume("above the group maximum");
+		}
+		if (sec->lot_step > 0 && trans.volume % sec->lot_step != 0)
+		{
+			return bad_volume("not a multiple of the group lot step");
+		}
+		return {};
+	}
+
+	// Server time is local to the server, so weekday and minute come straight from it.
+	trade_validator::result_t trade_validator::check_session(const ConSymbol& symbol, time_t now)
+	{
+		const auto closed = [&symbol]()
+		{
+			return tl::unexpected{ rejection{ RET_TRADE_MARKET_CLOSED, fmt::format("Market is closed for '{}'", symbol.symbol) } };
+		};
+		if ((symbol.starting != 0 && now < symbol.starting) || (symbol.expiration != 0 && now >= symbol.expiration))
+		{
+			return closed();
+		}
+
+		// 1970-01-01 was a Thursday, sessions[] starts with Sunday.
+		const auto weekday = static_cast<size_t>((now / seconds_per_day + 4) % 7);
+		const auto minute = static_cast<int>(now % seconds_per_day / 60);
+		for (const auto& session : symbol.sessions[weekday].trade)
+		{
+			if (in_session(session, minute))
+			{
+				return {};
+			}
+		}
+		return closed();
+	}
+
+	// A buy is closed at bid and a sell at ask, so stops keep stops_level points away from that side.
+	trade_validator::result_t trade_validator::check_stops(const TradeTransInfo& trans, const ConSymbol& symbol, const double (&prices)[2])
+	{
+		if (trans.sl == 0.0 && trans.tp == 0.0)
+		{
+			return {};
+		}
+		const auto price = trans.cmd == OP_BUY ? prices[0] : prices[1];
+		const auto distance = symbol.stops_level * symbol.point;
+		const auto epsilon = symbol.point / 2;
+		const auto bad = trans.cmd == OP_BUY
+			? (trans.sl != 0.0 && trans.sl > price - distance + epsilon) || (trans.tp != 0.0 && trans.tp < price + distance - epsilon)
+			: (trans.sl != 0.0 && trans.sl < price + distance - epsilon) || (trans.tp != 0.0 && trans.tp > price - distance + epsilon);
+		if (bad)
+		{
+			return tl::unexpected{ rejection{ RET_TRADE_BAD_STOPS, fmt::format("Stops {} / {} are closer than {} points to {}",
+				trans.sl, trans.tp, symbol.stops_level, price) } };
+		}
+		return {};
+	}
+
+	trade_validator::result_t trade_validator::compare(const char* check, const TradeTransInfo& trans, result_t&& local, int server_code) const
+	{
+		++m_metrics.parity_checks;
+		if (local.has_value() != (server_code == RET_OK))
+		{
+			++m_metrics.parity_mismatches;
+			m_logger.log_error("Validation parity: {} check for {} {} {:.2f} locally {}, server returned {}",
+				check, trans.symbol, trans.cmd, trans.volume / 100.0,
+				local ? std::string{ "passed" } : fmt::format("rejected with {} ({})", local.error().code, local.error().message), server_code);
+		}
+		return std::move(local);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <ctime>
+#include <string>
+
+#include <tl/expected.hpp>
+
+#include "registry.h"
+
+struct CServerInterface;
+struct ConGroup;
+struct ConSymbol;
+struct TradeTransInfo;
+
+namespace mt4
+{
+	class logger;
+	struct group_masks;
+	struct trade_metrics;
+
+	// Reject code is one of the server RET_* codes.
+	struct trade_rejection
+	{
+		int				code;
+		std::string		message;
+	};
+
+	// Repeats the server's pre-trade checks against the cached symbol and group configuration,
+	// so a request that would fail anyway is rejected before it takes the server's trade lock.
+	// In parity mode every check also runs the matching TradesCheck* call and logs any disagreement.
+	class trade_validator
+	{
+	public:
+		using result_t = tl::expected<void, trade_rejection>;
+
+		trade_validator(CServerInterface* mt4server, logger& log, trade_metrics& metrics, bool parity) noexcept;
+
+		// Group rights, symbol trade mode, volume and trade session. trans.type tells an opening
+		// from a closing, closings are allowed in close-only mode and below the minimal lot.
+		result_t validate(const TradeTransInfo& trans, const ConSymbol& symbol, const ConGroup& group, const group_masks& masks, symbol_id id) const;
+
+		// Runs once the group prices are known, prices[0] is bid and prices[1] is ask.
+		result_t validate_stops(const TradeTransInfo& trans, const ConSymbol& symbol, const ConGroup& group, const double (&prices)[2]) const;
+
+	private:
+		static result_t check_rights(const ConSymbol& symbol, const ConGroup& group);
+		static result_t check_mode(const TradeTransInfo& trans, const ConSymbol& symbol, const group_masks& masks, symbol_id id);
+		static result_t check_volume(const TradeTransInfo& trans, const ConSymbol& symbol, const ConGroup& group);
+		static result_t check_session(const ConSymbol& symbol, time_t now);
+		static result_t check_stops(const TradeTransInfo& trans, const ConSymbol& symbol, const double (&prices)[2]);
+
+		// Compares the local verdict with the server's one, returns the local verdict unchanged.
+		result_t compare(const char* check, const TradeTransInfo& trans, result_t&& local, int server_code) const;
+
+		CServerInterface*		m_mt4server;
+		logger&					m_logger;
+		trade_metrics&			m_metrics;
+		const bool				m_parity;
+	};
+}
\ No newline at end of file